@@ -44,9 +44,13 @@ Exemple compiled on linux with: -lglfw -lGL `pkg-config --cflags --libs freetype
 
 	#include<GLFW/glfw3.h>
 
-	#define TEXT_ENGINE_MAX_GLYPHS_COUNT 1024 //If you do not define it, the default is 512
+	#define TEXT_ENGINE_MAX_GLYPHS_COUNT 1024 //Characters loaded with the font, the default is 512 (others are loaded when first drawn)
 	
-	#define TEXT_ENGINE_USE_MODERN_OPENGL //If you do not define it, text engine will use the 1.1 immediate opengl mode
+	#define TEXT_ENGINE_ATLAS_PAGE_SIZE 2048 //If you do not define it, the default is 1024 (it grows for big font sizes)
+	
+	#define TEXT_ENGINE_MAX_ATLAS_PAGES 4 //If you do not define it, the default is 8
+	
+	#define TEXT_ENGINE_USE_MODERN_OPENGL //If you do not define it, text engine will use OpenGL 1.1 (client side vertex arrays)
 
 	#define TEXT_ENGINE_IMPLEMENTATION
 	#include"text_engine.h"
@@ -69,13 +73,50 @@ Exemple compiled on linux with: -lglfw -lGL `pkg-config --cflags --libs freetype
 		
 			glfwSwapBuffers(window);
 			
+			resetFontFrame();
+			
 		}
 		
-		free(font);
+		deleteFont(font);
 		
 		return 0;
 		
 	}
+	
+Memory: every allocation goes through TEXT_ENGINE_MALLOC, TEXT_ENGINE_REALLOC and TEXT_ENGINE_FREE (malloc, realloc and free if
+you do not define them). Scratch memory comes from a per frame arena, call resetFontFrame() once per frame after drawing.
+Once warmed up (batches and the arena grown to the biggest frame seen), drawing does no heap allocation: drawText,
+drawCenteredText, drawRightedText, the *TextFormat functions, the get*Text functions, the text index lookups, addFontLabel
+and drawFontLabelBatch.
+Only creating, loading, deleting, editing (text indexes), rendering a new text on drawCachedText and drawing a character
+for the first time allocate.
+
+Text is UTF-8. Characters below TEXT_ENGINE_MAX_GLYPHS_COUNT are loaded with the font, the others (Cyrillic, CJK, Arabic...)
+are rendered to the atlas the first time they are drawn, from the first face that has them (see addFontFallback).
+Bytes that are not valid UTF-8 are taken as Latin-1 characters. Text index positions are byte offsets.
+
+Metrics only: createFontMetrics loads just the glyph advances, without OpenGL and without rendering bitmaps, so it can be
+used on servers to measure text (get*Text functions and text indexes), and from many threads at the same time once created.
+Define TEXT_ENGINE_METRICS_ONLY to build the library without any OpenGL call (only metrics functions are available then).
+
+Tracing: define TEXT_ENGINE_TRACE and call startFontTrace("session.trace") to record every font creation, draw, measure and
+setting call with its arguments and time to a compact binary file. tools/text_engine_replay.cpp replays it on any build
+of the library and reports the timings.
+
+Fonts can also be loaded without blocking the frame, the font is usable as soon as isFontReady returns 1:
+
+	Font* font = createFontAsync("font.ttf",48);
+	
+	while(!glfwWindowShouldClose(window)){
+	
+		updateFontLoading(font,16384); //Rasterize and upload at most ~16KB of glyph bitmaps this frame
+		
+		if(isFontReady(font))
+			drawText(font, "Hello, World!", 0, 0);
+		
+		...
+		
+	}
 
 */
 	
@@ -83,6 +124,8 @@ Exemple compiled on linux with: -lglfw -lGL `pkg-config --cflags --libs freetype
 #define _TEXT_ENGINE
 
 #include<math.h>
+#include<stddef.h>
+#include<stdarg.h>
 
 #include<ft2build.h>
 #include FT_FREETYPE_H
@@ -103,25 +146,118 @@ Exemple compiled on linux with: -lglfw -lGL `pkg-config --cflags --libs freetype
 	#endif
 #endif
 
+//Lets GCC and Clang check the arguments of the formatted functions as they check printf ones
+#if defined(__GNUC__) || defined(__clang__)
+	#define TEXT_ENGINE_PRINTF_FORMAT(format_index,first_argument) __attribute__((format(printf,format_index,first_argument)))
+#else
+	#define TEXT_ENGINE_PRINTF_FORMAT(format_index,first_argument)
+#endif
+
 #ifndef TEXT_ENGINE_MAX_GLYPHS_COUNT
 #define TEXT_ENGINE_MAX_GLYPHS_COUNT 512
 #endif
 
+//Memory hooks, define the three of them before including this library to route its memory to your own allocator
+#ifndef TEXT_ENGINE_MALLOC
+#include<stdlib.h>
+#define TEXT_ENGINE_MALLOC(size) malloc(size)
+#define TEXT_ENGINE_REALLOC(pointer,size) realloc(pointer,size)
+#define TEXT_ENGINE_FREE(pointer) free(pointer)
+#endif
+
+#ifndef TEXT_ENGINE_FRAME_ARENA_SIZE
+#define TEXT_ENGINE_FRAME_ARENA_SIZE 262144 //Initial size of the per frame scratch memory, it grows to the biggest frame seen
+#endif
+
+#ifndef TEXT_ENGINE_ATLAS_PAGE_SIZE
+#define TEXT_ENGINE_ATLAS_PAGE_SIZE 1024
+#endif
+
+#ifndef TEXT_ENGINE_MAX_ATLAS_PAGES
+#define TEXT_ENGINE_MAX_ATLAS_PAGES 8
+#endif
+
+#ifndef TEXT_ENGINE_MAX_FONT_FACES
+#define TEXT_ENGINE_MAX_FONT_FACES 4 //Primary face plus fallbacks
+#endif
+
+#ifndef TEXT_ENGINE_BATCH_GLYPHS
+#define TEXT_ENGINE_BATCH_GLYPHS 128 //Glyphs held on the stack arrays of the OpenGL 1.1 drawText before each glDrawArrays
+#endif
+
+#ifndef TEXT_ENGINE_UPLOAD_BUFFER_SIZE
+#define TEXT_ENGINE_UPLOAD_BUFFER_SIZE 65536 //Size of the pixel buffer used to stream glyphs to the atlas on modern OpenGL
+#endif
+
+#ifndef TEXT_ENGINE_TEXT_CACHE_SIZE
+#define TEXT_ENGINE_TEXT_CACHE_SIZE 8388608 //Bytes of textures kept by drawCachedText (one byte per pixel), the least recently drawn texts are dropped past it
+#endif
+
+#ifndef TEXT_ENGINE_TEXT_CACHE_ENTRIES
+#define TEXT_ENGINE_TEXT_CACHE_ENTRIES 64 //Texts kept by drawCachedText
+#endif
+
 typedef struct{
 
-	unsigned int texture;
-	int left, top;
-	unsigned int width, rows;
-	long int advance;
+	unsigned short page, x, y; //Position of the bitmap on the atlas pages
+	short left, top;
+	unsigned short width, rows;
+
+}Letter; //Render data of a glyph, only touched by drawText
+
+typedef struct{
+
+	unsigned int code; //Character, 0 on empty slots
+	short advance;
+	unsigned char rendered; //Letter is on the atlas, glyphs are rendered the first time they are drawn
+	unsigned char missing; //No face has the character, the missing glyph of the font is drawn for it
+	Letter letter;
+
+}FontGlyph; //Character from TEXT_ENGINE_MAX_GLYPHS_COUNT up, kept on the glyph table of the font
+
+typedef struct{
+
+	unsigned int first, last;
+
+}FontCharRange; //Characters a face has, faces keep them sorted so finding the face of a character is a binary search
+
+typedef struct{
+
+	size_t used;
+	void* overflow;
 
-}Letter;
+}FontFrameMark; //Position on the per frame scratch memory, to give back what was taken after it
 
 typedef struct{
 
-	int size, tab_size;
+	//Hot metrics, kept at the top of the struct so measuring ASCII text only touches the first cache lines of the font
+	int size, tab_size, tab_width, tab_unit; //tab_width = tab_unit * tab_size
+	int metrics_only; //Created by createFontMetrics, the render data is left empty and drawing or loading calls do nothing
+	int trace_id; //Identifies the font on traces, see TEXT_ENGINE_TRACE
+	int digit_advance; //Widest advance of '0' to '9', every digit of a formatted number takes it, so numbers do not shake when they change
 	float scale_x, scale_y;
+	short advances[TEXT_ENGINE_MAX_GLYPHS_COUNT]; //Glyph advances already in pixels (FreeType advance >> 6)
+	FontGlyph* glyphs; //Open addressing table of the characters past advances, by code point
+	int glyphs_count, glyphs_capacity;
+	FontGlyph missing_glyph; //Glyph of the characters no face has, its advance is loaded with the font
+	
+	//Cold render data
 	Letter letters[TEXT_ENGINE_MAX_GLYPHS_COUNT];
 	
+	unsigned int pages[TEXT_ENGINE_MAX_ATLAS_PAGES];
+	int pages_count, page_size;
+	int pen_x, pen_y, shelf_height; //Shelf packing cursor on the last page
+	
+	//Loading state, glyphs below TEXT_ENGINE_MAX_GLYPHS_COUNT are loaded in order, so ASCII is always ready first (the others when first drawn)
+	FT_Library ft_library;
+	FT_Face ft_faces[TEXT_ENGINE_MAX_FONT_FACES]; //Primary face and its fallbacks, open while the font lives to load characters when first used
+	int faces_count;
+	FontCharRange* faces_ranges[TEXT_ENGINE_MAX_FONT_FACES]; //Characters of each face, read once from its charmap
+	int faces_ranges_count[TEXT_ENGINE_MAX_FONT_FACES];
+	int loaded_glyphs;
+	unsigned int pixel_buffer;
+	int application_pixel_buffer; //Pixel unpack buffer bound when an upload began, bound again when it ends
+	
 	float depth;
 	
 	float color_r, color_g, color_b, color_a;
@@ -130,20 +266,144 @@ typedef struct{
 	float projection_matrix[16];
 	int canvas_width, canvas_height, canvas_depth;
 	
-	unsigned int shader, vertex_array;
+	unsigned int shader, vertex_array, vertex_buffers[2];
 	
 	int free_transform;
 
 }Font;
 
+typedef void (*FontFormatSink)(Font* font, void* sink, unsigned int c, int digit); //Takes the characters of a formatted text one by one, digit is 1 on the digits of numbers
+
+typedef struct{
+
+	int start, length, capacity; //Index of the first character of the line in the text, the '\n' is not part of the line
+	int* prefix; //prefix[i] is the x of the caret before character i, so prefix[length] is the line width
+
+}TextIndexLine;
+
+typedef struct{
+
+	Font* font;
+	int length; //Characters on the indexed text
+	int lines_count, lines_capacity;
+	TextIndexLine* lines;
+
+}TextIndex;
+
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+
+typedef struct{
+
+	Font* font;
+	
+	int labels_count, labels_capacity;
+	float* matrices; //One 4x4 transform per label, read by the shader from matrices_texture
+	
+	int glyphs_count, glyphs_capacity;
+	float* vertices; //6 vertices per glyph: x, y, depth, u, v, label
+	unsigned short* glyph_pages;
+	int page_glyphs[TEXT_ENGINE_MAX_ATLAS_PAGES];
+	
+	unsigned int shader, vertex_array, vertex_buffer, matrices_texture;
+	int matrices_rows;
+
+}FontLabelBatch;
+
+typedef struct{
+
+	//What the texture was rendered from, the text is rendered again when any of it changes
+	Font* font;
+	unsigned char* text;
+	int length;
+	unsigned int hash;
+	float scale_x, scale_y;
+	int tab_width, loaded_glyphs, faces_count;
+	
+	int left, top, right, bottom; //Bounds of the glyphs relative to the text position, before the font scale
+	int texture_width, texture_height;
+	unsigned int texture;
+	unsigned int last_use;
+
+}FontCachedText; //Text block rendered once to a texture by drawCachedText
+
+#endif //TEXT_ENGINE_USE_MODERN_OPENGL
+
+//Trace records: unsigned char op, long long nanoseconds since startFontTrace, int font trace_id, then the arguments
+//below (strings are an unsigned int length followed by the characters). The file starts with "TETR" and the version.
+//Compound calls are recorded as the calls they are made of (createFont is CREATE_FONT plus UPDATE_FONT_LOADING calls,
+//drawCenteredText is GET_SIZE_TEXT plus DRAW_TEXT, and so on), so replaying them does the same work.
+#define TEXT_ENGINE_TRACE_VERSION 1
+
+enum{
+	TEXT_ENGINE_TRACE_CREATE_FONT = 1, //int size, string font_name
+	TEXT_ENGINE_TRACE_CREATE_FONT_METRICS, //int size, string font_name
+	TEXT_ENGINE_TRACE_UPDATE_FONT_LOADING, //int bytes_budget
+	TEXT_ENGINE_TRACE_ADD_FONT_FALLBACK, //string font_name
+	TEXT_ENGINE_TRACE_DELETE_FONT,
+	TEXT_ENGINE_TRACE_DRAW_TEXT, //int x, int y, string text
+	TEXT_ENGINE_TRACE_GET_SIZE_TEXT, //string text
+	TEXT_ENGINE_TRACE_GET_HEIGHT_TEXT, //string text
+	TEXT_ENGINE_TRACE_SET_FONT_COLOR, //float r, float g, float b, float a
+	TEXT_ENGINE_TRACE_SET_FONT_SCALE, //float scale_x, float scale_y (setFontScale and setFontScaleInPixels)
+	TEXT_ENGINE_TRACE_SET_FONT_DEPTH, //float depth
+	TEXT_ENGINE_TRACE_SET_TAB_SIZE, //int tab_size
+	TEXT_ENGINE_TRACE_SET_FONT_CANVAS_SIZE, //int width, int height, int depth
+	TEXT_ENGINE_TRACE_SET_FONT_FREE_TRANSFORM, //int free_transform
+	TEXT_ENGINE_TRACE_FRAME, //resetFontFrame
+	TEXT_ENGINE_TRACE_DRAW_CACHED_TEXT //int x, int y, string text
+};
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
 TEXTENGINEDEF Font* createFont(const char* font_name, int size);
 
+TEXTENGINEDEF Font* createFontAsync(const char* font_name, int size); //Return the font without glyphs, they are loaded by updateFontLoading.
+
+TEXTENGINEDEF int updateFontLoading(Font* font, int bytes_budget); //Rasterize and upload glyphs until bytes_budget bytes of bitmaps are sent, return 1 when all glyphs are loaded.
+
+TEXTENGINEDEF int isFontReady(Font* font); //Return 1 when all ASCII glyphs are loaded.
+
+//Faces are searched in the order they were added, so a fallback with CJK or Arabic gives the characters the primary face lacks.
+TEXTENGINEDEF int addFontFallback(Font* font, const char* font_name); //Characters missing on the font faces are taken from this one, return 0 on failure.
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+//Font without OpenGL, only for metrics (get*Text functions, text indexes, scale and tab size). Drawing calls given a metrics font
+//draw nothing, isFontReady returns 0, and createFontLabelBatch and addFontFallback fail.
+TEXTENGINEDEF Font* createFontMetrics(const char* font_name, int size);
+
+TEXTENGINEDEF void deleteFont(Font* font);
+
+TEXTENGINEDEF void resetFontFrame(); //Call once per frame, after drawing, to recycle the scratch memory used on the frame.
+
+TEXTENGINEDEF void deleteFontFrameMemory(); //Give the scratch memory back to the allocator, like when closing the program.
+
+#ifdef TEXT_ENGINE_TRACE
+
+TEXTENGINEDEF int startFontTrace(const char* file_name); //Record the calls made to the library on file_name (start it before creating fonts), return 0 on failure.
+
+TEXTENGINEDEF void stopFontTrace();
+
+#endif //TEXT_ENGINE_TRACE
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
 TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y);
 
 TEXTENGINEDEF void drawCenteredText(Font* font, const unsigned char* text, int x, int y);
 
 TEXTENGINEDEF void drawRightedText(Font* font, const unsigned char* text, int x, int y);
 
+//Formatted draws take printf style formats (%d %i %u %o %x %X %f %c %s %%, with the flags - + space 0 #, width and precision, hh h l ll z t
+//L sizes). Other printf conversions (%e %g %a %p %n) take their argument and are written as they are, the format stops at any other one.
+//Numbers are drawn while formatted, without building a string, and their digits have the same advance (see font->digit_advance).
+
+TEXTENGINEDEF void drawTextFormat(Font* font, int x, int y, const char* format, ...) TEXT_ENGINE_PRINTF_FORMAT(4,5);
+
+TEXTENGINEDEF void drawCenteredTextFormat(Font* font, int x, int y, const char* format, ...) TEXT_ENGINE_PRINTF_FORMAT(4,5);
+
+TEXTENGINEDEF void drawRightedTextFormat(Font* font, int x, int y, const char* format, ...) TEXT_ENGINE_PRINTF_FORMAT(4,5);
+
 TEXTENGINEDEF void setFontFreeTransform(Font* font, int free_transform); //Able you to change font->matrix_transform variable by yourself.
 
 TEXTENGINEDEF void setFontDepth(Font* font, float depth);
@@ -152,6 +412,8 @@ TEXTENGINEDEF void setFontColor(Font* font, float r, float g, float b, float a);
 
 TEXTENGINEDEF void setFontCanvasSize(Font* font, int width, int height, int depth); //Set size of values that will be share with orthographic matrix.
 
+#endif //TEXT_ENGINE_METRICS_ONLY
+
 TEXTENGINEDEF void setTabSize(Font* font, const int tab_size);
 
 TEXTENGINEDEF void setFontScale(Font* font, float scale); //Scale is not equal as font pixels size
@@ -164,6 +426,8 @@ TEXTENGINEDEF int getSizeText(Font* font, const unsigned char* text);
 
 TEXTENGINEDEF int getHeightText(Font* font, const unsigned char* text);
 
+TEXTENGINEDEF int getSizeTextFormat(Font* font, const char* format, ...) TEXT_ENGINE_PRINTF_FORMAT(2,3); //getSizeText of the formatted text, as drawTextFormat draws it
+
 TEXTENGINEDEF int getFontHeight(Font* font); //Return font->size * font->scale_y;
 
 TEXTENGINEDEF int getTextAlignRight(Font* font, const unsigned char* text, int position_x);
@@ -172,6 +436,142 @@ TEXTENGINEDEF int getTextAlignCenter(Font* font, const unsigned char* text, int
 
 TEXTENGINEDEF int getTextAABB(Font* font, const unsigned char* text, int text_x, int text_y, int x, int y, int w, int h, int text_align);
 
+//Text indexes map points to character indexes (and back) of a text, for carets and selections on text editors.
+//Points are relative to the position given to drawText. The index keeps the advances of the text, not the text itself,
+//so insertTextIndex and eraseTextIndex must follow every change made on the text.
+
+TEXTENGINEDEF TextIndex* createTextIndex(Font* font, const unsigned char* text);
+
+TEXTENGINEDEF int getTextIndexAtPoint(TextIndex* index, int x, int y); //Return the character index closest to the point
+
+TEXTENGINEDEF void getTextIndexPoint(TextIndex* index, int position, int* x, int* y); //Return the top left point of the caret before the character
+
+TEXTENGINEDEF int getTextSelectionRects(TextIndex* index, int start, int end, int* rects, int max_rects); //Write x, y, w, h of each selected line on rects, return the rects count
+
+TEXTENGINEDEF void insertTextIndex(TextIndex* index, int position, const unsigned char* text, int length);
+
+TEXTENGINEDEF void eraseTextIndex(TextIndex* index, int position, int length);
+
+TEXTENGINEDEF void deleteTextIndex(TextIndex* index);
+
+#if defined(TEXT_ENGINE_USE_MODERN_OPENGL) && !defined(TEXT_ENGINE_METRICS_ONLY)
+
+//Label batches draw many strings, each one with its own transform and depth, with one draw call per atlas page.
+//Labels are drawn with font->projection_matrix * transform, so a transform can hold the whole world to canvas matrix.
+
+TEXTENGINEDEF FontLabelBatch* createFontLabelBatch(Font* font);
+
+TEXTENGINEDEF void addFontLabel(FontLabelBatch* batch, const unsigned char* text, float* transform, float depth); //The transform (4x4) is copied
+
+TEXTENGINEDEF void clearFontLabelBatch(FontLabelBatch* batch); //Remove all labels, keeping the memory for the next frame
+
+TEXTENGINEDEF void drawFontLabelBatch(FontLabelBatch* batch);
+
+TEXTENGINEDEF void deleteFontLabelBatch(FontLabelBatch* batch);
+
+//Cached texts are rendered once to a texture and then drawn as a single quad, for big static texts (help pages, credits).
+//The texture is rendered again when the text, font scale, tab size or glyphs change, color, depth and position are free.
+//Textures are kept up to TEXT_ENGINE_TEXT_CACHE_SIZE bytes, dropping the least recently drawn texts past it.
+
+TEXTENGINEDEF void drawCachedText(Font* font, const unsigned char* text, int x, int y);
+
+TEXTENGINEDEF void deleteFontTextCache(); //Delete the textures kept by drawCachedText.
+
+#endif //TEXT_ENGINE_USE_MODERN_OPENGL
+
+//Internal Functions
+TEXTENGINEDEF void* fontFrameAlloc(size_t size); //Scratch memory valid until resetFontFrame, or until released with a mark
+
+TEXTENGINEDEF FontFrameMark fontGetFrameMark();
+
+TEXTENGINEDEF void fontReleaseFrameMark(FontFrameMark mark);
+
+TEXTENGINEDEF unsigned int fontDecodeUTF8(const unsigned char** text, int available); //Return the character at *text and move past it, reading at most available bytes
+
+TEXTENGINEDEF FontGlyph* fontInsertGlyph(Font* font, unsigned int c); //Add an empty slot for the character on the glyph table
+
+TEXTENGINEDEF FontGlyph* fontFindGlyph(Font* font, unsigned int c); //Glyph of a character from TEXT_ENGINE_MAX_GLYPHS_COUNT up, added with its advance the first time
+
+TEXTENGINEDEF int fontGetAdvance(Font* font, unsigned int c);
+
+#ifdef TEXT_ENGINE_TRACE
+
+TEXTENGINEDEF int fontTraceBegin(int op, Font* font); //Write the record header, return 0 when no trace is being recorded
+
+TEXTENGINEDEF void fontTraceInt(int value);
+
+TEXTENGINEDEF void fontTraceFloat(float value);
+
+TEXTENGINEDEF void fontTraceString(const unsigned char* text);
+
+#endif //TEXT_ENGINE_TRACE
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
+TEXTENGINEDEF int fontInitLoading(Font* font, const char* font_name, int size);
+
+TEXTENGINEDEF int fontOpenFace(Font* font, const char* font_name);
+
+TEXTENGINEDEF void fontCloseFaces(Font* font);
+
+TEXTENGINEDEF void fontBeginUpload(Font* font);
+
+TEXTENGINEDEF int fontFindCharFace(Font* font, unsigned int c); //Return the first face that has the character, -1 when none has it
+
+TEXTENGINEDEF int fontLoadGlyph(Font* font, unsigned int c, Letter* letter, short* advance, int uploaded_bytes); //Return the bytes uploaded
+
+TEXTENGINEDEF FontGlyph* fontAddGlyph(Font* font, unsigned int c); //Add the character to the glyph table, with the advance of the face that has it
+
+TEXTENGINEDEF Letter* fontGetLetter(Font* font, unsigned int c, int* advance); //Render data of a character, rendered to the atlas the first time it is drawn
+
+TEXTENGINEDEF void fontEndUpload(Font* font);
+
+TEXTENGINEDEF int fontAddAtlasPage(Font* font);
+
+TEXTENGINEDEF int fontPackGlyph(Font* font, Letter* letter);
+
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+
+TEXTENGINEDEF FontCachedText* fontCacheText(Font* font, const unsigned char* text); //Return the up to date texture of the text, 0 when it can not be cached
+
+TEXTENGINEDEF void fontRenderCachedText(Font* font, FontCachedText* cached, const unsigned char* text);
+
+TEXTENGINEDEF void fontEvictCachedText(int index);
+
+TEXTENGINEDEF void fontDeleteCachedTexts(Font* font); //Delete the cached texts of the font, or all of them when font is 0
+
+#endif //TEXT_ENGINE_USE_MODERN_OPENGL
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+TEXTENGINEDEF void fontFormatText(Font* font, FontFormatSink put, void* sink, const char* format, va_list args);
+
+TEXTENGINEDEF void fontFormatInteger(Font* font, FontFormatSink put, void* sink, unsigned long long value, int base, int upper_case, int alternate, char sign, int width, int precision, int zero_pad, int left_justify);
+
+TEXTENGINEDEF void fontFormatFloat(Font* font, FontFormatSink put, void* sink, double value, int precision, int alternate, char sign, int width, int zero_pad, int left_justify);
+
+TEXTENGINEDEF void fontMeasureSink(Font* font, void* sink, unsigned int c, int digit);
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
+TEXTENGINEDEF void fontPenSink(Font* font, void* sink, unsigned int c, int digit);
+
+TEXTENGINEDEF void fontDrawTextFormat(Font* font, int x, int y, int text_align, const char* format, va_list args); //text_align: 0 left, 1 centered, 2 righted
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+#ifdef TEXT_ENGINE_TRACE
+
+TEXTENGINEDEF void fontTraceSink(Font* font, void* sink, unsigned int c, int digit);
+
+TEXTENGINEDEF void fontTraceFormat(Font* font, const char* format, va_list args); //Write the formatted text as a string argument
+
+#endif //TEXT_ENGINE_TRACE
+
+TEXTENGINEDEF void fontReserveTextIndexLine(TextIndexLine* line, int length);
+
+TEXTENGINEDEF int fontFindTextIndexLine(TextIndex* index, int position);
+
 //Internal Math Functions
 TEXTENGINEDEF void fontMultiplyMatrix4x4(float* m1, float* m2, float* dest);
 
@@ -191,77 +591,670 @@ TEXTENGINEDEF void fontCreateOrthographicMatrix(float left, float right, float b
 
 #ifdef TEXT_ENGINE_IMPLEMENTATION
 
-//============================== If Using Modern OpenGL ==============================
+//============================== Frame Memory ==============================
 
-#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+typedef struct FontFrameBlock{
 
-TEXTENGINEDEF Font* createFont(const char* font_name, int size){
+	struct FontFrameBlock* next;
+	size_t size;
 
-	Font* font = (Font*)malloc(sizeof(Font));
-	font->size = size;
-	font->tab_size = 4;
-	font->scale_x = 1.0f, font->scale_y = 1.0f;
-	float gl_current_view_port[4];
-	glGetFloatv(GL_VIEWPORT,gl_current_view_port);
-	font->canvas_width = gl_current_view_port[2];
-	font->canvas_height = gl_current_view_port[3];
-	font->canvas_depth = 1000000;
-	font->depth = 0.0;
-	font->color_r = 1.0f;
-	font->color_g = 1.0f;
-	font->color_b = 1.0f;
-	font->color_a = 1.0f;
-	font->free_transform = 0;
+}FontFrameBlock; //Header of a heap block, used when a frame needs more scratch memory than the arena has
+
+static struct{
+
+	unsigned char* memory;
+	size_t capacity, used;
+	FontFrameBlock* overflow;
+	size_t overflow_size, peak_size; //Peak of the frame, the arena grows to it on resetFontFrame
+
+}font_frame_arena;
+
+TEXTENGINEDEF void* fontFrameAlloc(size_t size){
+
+	size = (size + 15) & ~(size_t)15;
 	
-	for(int i = 0; i < 16; i++) font->projection_matrix[i] = 0.0f;
-	font->projection_matrix[0] = font->projection_matrix[5] = font->projection_matrix[10] = font->projection_matrix[15] = 1.0f;
-	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth,font->projection_matrix);
+	if(!font_frame_arena.memory){
+		font_frame_arena.capacity = TEXT_ENGINE_FRAME_ARENA_SIZE;
+		font_frame_arena.memory = (unsigned char*)TEXT_ENGINE_MALLOC(font_frame_arena.capacity);
+	}
 	
-	for(int i = 0; i < 16; i++) font->transform_matrix[i] = 0.0f;
-	font->transform_matrix[0] = font->transform_matrix[5] = font->transform_matrix[10] = font->transform_matrix[15] = 1.0f;
-	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth,font->transform_matrix);
+	void* pointer;
+	
+	if(font_frame_arena.used + size <= font_frame_arena.capacity){
+		pointer = font_frame_arena.memory + font_frame_arena.used;
+		font_frame_arena.used += size;
+	}else{ //Arena is full, the next resetFontFrame grows it to the peak of this frame
+		FontFrameBlock* block = (FontFrameBlock*)TEXT_ENGINE_MALLOC(sizeof(FontFrameBlock) + size);
+		block->next = font_frame_arena.overflow;
+		block->size = size;
+		font_frame_arena.overflow = block;
+		font_frame_arena.overflow_size += size;
+		pointer = block + 1;
+	}
 	
-	FT_Library ft;
-	if( FT_Init_FreeType(&ft) ){
-		puts("Text Engine: Failed to init FreeType2 Library");
-		return 0;
+	if(font_frame_arena.peak_size < font_frame_arena.used + font_frame_arena.overflow_size)
+		font_frame_arena.peak_size = font_frame_arena.used + font_frame_arena.overflow_size;
+	
+	return pointer;
+
+}
+
+TEXTENGINEDEF FontFrameMark fontGetFrameMark(){
+
+	FontFrameMark mark;
+	mark.used = font_frame_arena.used;
+	mark.overflow = font_frame_arena.overflow;
+	
+	return mark;
+
+}
+
+TEXTENGINEDEF void fontReleaseFrameMark(FontFrameMark mark){
+
+	while(font_frame_arena.overflow != mark.overflow){
+		FontFrameBlock* next = font_frame_arena.overflow->next;
+		font_frame_arena.overflow_size -= font_frame_arena.overflow->size;
+		TEXT_ENGINE_FREE(font_frame_arena.overflow);
+		font_frame_arena.overflow = next;
 	}
-	FT_Face face;
-	if( FT_New_Face(ft,font_name,0,&face) ){
-		printf("Text Engine: Failed to load font: %s\n",font_name);
-		return 0;
+	
+	font_frame_arena.used = mark.used;
+
+}
+
+TEXTENGINEDEF void resetFontFrame(){
+
+#ifdef TEXT_ENGINE_TRACE
+	fontTraceBegin(TEXT_ENGINE_TRACE_FRAME,0);
+#endif
+
+	FontFrameMark start = {0,0};
+	fontReleaseFrameMark(start);
+	
+	if(font_frame_arena.peak_size > font_frame_arena.capacity){
+		TEXT_ENGINE_FREE(font_frame_arena.memory);
+		font_frame_arena.capacity = font_frame_arena.peak_size;
+		font_frame_arena.memory = (unsigned char*)TEXT_ENGINE_MALLOC(font_frame_arena.capacity);
 	}
-	FT_Set_Pixel_Sizes(face,0,size);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	
+	font_frame_arena.peak_size = 0;
 
-	for(int i = 0; i < TEXT_ENGINE_MAX_GLYPHS_COUNT; i++){
+}
+
+TEXTENGINEDEF void deleteFontFrameMemory(){
+
+	resetFontFrame();
 	
-		FT_Load_Char(face,i,FT_LOAD_RENDER);
-		
-		glGenTextures(1,&font->letters[i].texture);
-		glBindTexture(GL_TEXTURE_2D,font->letters[i].texture);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA,face->glyph->bitmap.width,face->glyph->bitmap.rows,0,GL_ALPHA,GL_UNSIGNED_BYTE,face->glyph->bitmap.buffer);
-		glBindTexture(GL_TEXTURE_2D,0);
-		
-		font->letters[i].left = face->glyph->bitmap_left;
-		font->letters[i].top = face->glyph->bitmap_top;
-		font->letters[i].width = face->glyph->bitmap.width;
-		font->letters[i].rows = face->glyph->bitmap.rows;
-		font->letters[i].advance = face->glyph->advance.x;
-		
+	TEXT_ENGINE_FREE(font_frame_arena.memory);
+	font_frame_arena.memory = 0;
+	font_frame_arena.capacity = 0;
+
+}
+
+//============================== Trace ==============================
+
+#ifdef TEXT_ENGINE_TRACE
+
+#include<stdio.h>
+#include<time.h>
+
+static FILE* font_trace_file;
+static long long font_trace_start;
+static int font_trace_ids;
+
+static long long fontTraceTime(){
+
+	struct timespec time;
+	timespec_get(&time,TIME_UTC);
+	
+	return time.tv_sec * 1000000000LL + time.tv_nsec;
+
+}
+
+TEXTENGINEDEF int startFontTrace(const char* file_name){
+
+	if(font_trace_file) stopFontTrace();
+	
+	font_trace_file = fopen(file_name,"wb");
+	if(!font_trace_file){
+		printf("Text Engine: Failed to create trace: %s\n",file_name);
+		return 0;
 	}
+	
+	int version = TEXT_ENGINE_TRACE_VERSION;
+	fwrite("TETR",1,4,font_trace_file);
+	fwrite(&version,sizeof(int),1,font_trace_file);
+	font_trace_start = fontTraceTime();
+	
+	return 1;
+
+}
+
+TEXTENGINEDEF void stopFontTrace(){
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if(!font_trace_file) return;
 	
-	//Setting Shader
-	const char* vertex_shader_source = R"(
+	fclose(font_trace_file);
+	font_trace_file = 0;
+
+}
+
+TEXTENGINEDEF int fontTraceBegin(int op, Font* font){
+
+	if(!font_trace_file) return 0;
 	
-		#version 110
-		
+	unsigned char code = op;
+	long long time = fontTraceTime() - font_trace_start;
+	int id = font ? font->trace_id : 0;
+	fwrite(&code,1,1,font_trace_file);
+	fwrite(&time,sizeof(long long),1,font_trace_file);
+	fwrite(&id,sizeof(int),1,font_trace_file);
+	
+	return 1;
+
+}
+
+TEXTENGINEDEF void fontTraceInt(int value){
+	fwrite(&value,sizeof(int),1,font_trace_file);
+}
+
+TEXTENGINEDEF void fontTraceFloat(float value){
+	fwrite(&value,sizeof(float),1,font_trace_file);
+}
+
+TEXTENGINEDEF void fontTraceString(const unsigned char* text){
+	unsigned int length = strlen((const char*)text);
+	fwrite(&length,sizeof(unsigned int),1,font_trace_file);
+	fwrite(text,1,length,font_trace_file);
+}
+
+typedef struct{
+
+	unsigned char text[1024];
+	int length;
+
+}FontTraceText; //Formatted text of a traced call, longer texts are cut
+
+TEXTENGINEDEF void fontTraceSink(Font* font, void* sink, unsigned int c, int digit){
+
+	FontTraceText* trace_text = (FontTraceText*)sink;
+	
+	//Written back as UTF-8, only whole characters fit
+	unsigned char bytes[4];
+	int length = 0;
+	if(c < 0x80){
+		bytes[length++] = c;
+	}else if(c < 0x800){
+		bytes[length++] = 0xC0 | c>>6;
+		bytes[length++] = 0x80 | (c & 0x3F);
+	}else if(c < 0x10000){
+		bytes[length++] = 0xE0 | c>>12;
+		bytes[length++] = 0x80 | (c>>6 & 0x3F);
+		bytes[length++] = 0x80 | (c & 0x3F);
+	}else{
+		bytes[length++] = 0xF0 | c>>18;
+		bytes[length++] = 0x80 | (c>>12 & 0x3F);
+		bytes[length++] = 0x80 | (c>>6 & 0x3F);
+		bytes[length++] = 0x80 | (c & 0x3F);
+	}
+	
+	if(trace_text->length + length < (int)sizeof(trace_text->text)){
+		memcpy(trace_text->text + trace_text->length,bytes,length);
+		trace_text->length += length;
+	}
+
+}
+
+TEXTENGINEDEF void fontTraceFormat(Font* font, const char* format, va_list args){
+
+	FontTraceText trace_text;
+	trace_text.length = 0;
+	
+	fontFormatText(font,fontTraceSink,&trace_text,format,args);
+	trace_text.text[trace_text.length] = 0;
+	
+	fontTraceString(trace_text.text);
+
+}
+
+#endif //TEXT_ENGINE_TRACE
+
+//============================== Characters ==============================
+
+TEXTENGINEDEF unsigned int fontDecodeUTF8(const unsigned char** text, int available){
+
+	const unsigned char* t = *text;
+	unsigned int lead = t[0];
+	int length = lead < 0xC2 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 1;
+	
+	if(length > 1 && length <= available){
+		static const unsigned int minimums[5] = {0,0,0x80,0x800,0x10000};
+		unsigned int c = lead & (0x7F >> length);
+		int k = 1;
+		for(; k < length && (t[k] & 0xC0) == 0x80; k++) c = c << 6 | (t[k] & 0x3F);
+		if(k == length && c >= minimums[length] && c <= 0x10FFFF && (c < 0xD800 || c > 0xDFFF)){
+			*text = t + length;
+			return c;
+		}
+	}
+	
+	//Not UTF-8 (overlong, cut or stray bytes), the byte is taken as a Latin-1 character
+	*text = t + 1;
+	return lead;
+
+}
+
+TEXTENGINEDEF FontGlyph* fontInsertGlyph(Font* font, unsigned int c){
+
+	//Kept at most half full, so probes stay short
+	if((font->glyphs_count + 1) * 2 > font->glyphs_capacity){
+	
+		FontGlyph* old_glyphs = font->glyphs;
+		int old_capacity = font->glyphs_capacity;
+		
+		font->glyphs_capacity = old_capacity ? old_capacity * 2 : 256;
+		font->glyphs = (FontGlyph*)TEXT_ENGINE_MALLOC(sizeof(FontGlyph)*font->glyphs_capacity);
+		memset(font->glyphs,0,sizeof(FontGlyph)*font->glyphs_capacity);
+		
+		unsigned int mask = font->glyphs_capacity - 1;
+		for(int i = 0; i < old_capacity; i++){
+			if(!old_glyphs[i].code) continue;
+			unsigned int slot = old_glyphs[i].code * 2654435761u & mask;
+			while(font->glyphs[slot].code) slot = (slot + 1) & mask;
+			font->glyphs[slot] = old_glyphs[i];
+		}
+		
+		if(old_glyphs) TEXT_ENGINE_FREE(old_glyphs);
+		
+	}
+	
+	unsigned int mask = font->glyphs_capacity - 1;
+	unsigned int slot = c * 2654435761u & mask;
+	while(font->glyphs[slot].code) slot = (slot + 1) & mask;
+	
+	font->glyphs[slot].code = c;
+	font->glyphs_count++;
+	
+	return &font->glyphs[slot];
+
+}
+
+TEXTENGINEDEF FontGlyph* fontFindGlyph(Font* font, unsigned int c){
+
+	if(font->glyphs_capacity){
+		unsigned int mask = font->glyphs_capacity - 1;
+		for(unsigned int slot = c * 2654435761u & mask; font->glyphs[slot].code; slot = (slot + 1) & mask)
+			if(font->glyphs[slot].code == c) return &font->glyphs[slot];
+	}
+	
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	if(!font->metrics_only) return fontAddGlyph(font,c);
+#endif
+
+	return &font->missing_glyph; //Metrics fonts have every character of their face on the table since created
+
+}
+
+TEXTENGINEDEF int fontGetAdvance(Font* font, unsigned int c){
+
+	if(c < TEXT_ENGINE_MAX_GLYPHS_COUNT) return font->advances[c];
+	
+	return fontFindGlyph(font,c)->advance;
+
+}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
+//============================== Internal Functions ==============================
+
+TEXTENGINEDEF int fontInitLoading(Font* font, const char* font_name, int size){
+
+	font->faces_count = 0;
+	
+	if( FT_Init_FreeType(&font->ft_library) ){
+		puts("Text Engine: Failed to init FreeType2 Library");
+		return 0;
+	}
+	if(!fontOpenFace(font,font_name)){
+		FT_Done_FreeType(font->ft_library);
+		return 0;
+	}
+	
+	//Glyphs not loaded yet have no size and no advance, so they are just skipped when drawn
+	memset(font->advances,0,sizeof(font->advances));
+	memset(font->letters,0,sizeof(font->letters));
+	memset(font->pages,0,sizeof(font->pages));
+	font->glyphs = 0;
+	font->glyphs_count = font->glyphs_capacity = 0;
+	memset(&font->missing_glyph,0,sizeof(FontGlyph));
+	if(!FT_Load_Glyph(font->ft_faces[0],0,FT_LOAD_DEFAULT))
+		font->missing_glyph.advance = font->ft_faces[0]->glyph->advance.x>>6;
+	font->loaded_glyphs = 0;
+	font->metrics_only = 0;
+	font->digit_advance = 0;
+	font->tab_width = font->tab_unit = 0;
+	
+	font->pages_count = 0;
+	font->page_size = TEXT_ENGINE_ATLAS_PAGE_SIZE;
+	while(font->page_size < size * 8) font->page_size *= 2;
+	
+	font->pixel_buffer = 0;
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	glGenBuffers(1,&font->pixel_buffer);
+#endif
+
+#ifdef TEXT_ENGINE_TRACE
+	font->trace_id = ++font_trace_ids;
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_CREATE_FONT,font)){
+		fontTraceInt(size);
+		fontTraceString((const unsigned char*)font_name);
+	}
+#endif
+
+	return 1;
+	
+}
+
+TEXTENGINEDEF int fontOpenFace(Font* font, const char* font_name){
+
+	if(font->faces_count >= TEXT_ENGINE_MAX_FONT_FACES){
+		puts("Text Engine: Font faces limit reached, increase TEXT_ENGINE_MAX_FONT_FACES");
+		return 0;
+	}
+	
+	FT_Face face;
+	if( FT_New_Face(font->ft_library,font_name,0,&face) ){
+		printf("Text Engine: Failed to load font: %s\n",font_name);
+		return 0;
+	}
+	FT_Set_Pixel_Sizes(face,0,font->size);
+	
+	//Coverage is read once from the charmap as ranges of consecutive characters (it lists them in order), so choosing the
+	//face of a character is a binary search instead of a FT_Get_Char_Index on every face
+	FontCharRange* ranges = 0;
+	int ranges_count = 0, ranges_capacity = 0;
+	
+	FT_UInt glyph_index;
+	FT_ULong c = FT_Get_First_Char(face,&glyph_index);
+	while(glyph_index){
+		if(ranges_count && ranges[ranges_count-1].last + 1 == c){
+			ranges[ranges_count-1].last = c;
+		}else{
+			if(ranges_count == ranges_capacity){
+				ranges_capacity = ranges_capacity ? ranges_capacity * 2 : 64;
+				ranges = (FontCharRange*)TEXT_ENGINE_REALLOC(ranges,sizeof(FontCharRange)*ranges_capacity);
+			}
+			ranges[ranges_count].first = ranges[ranges_count].last = c;
+			ranges_count++;
+		}
+		c = FT_Get_Next_Char(face,c,&glyph_index);
+	}
+	
+	font->faces_ranges[font->faces_count] = ranges;
+	font->faces_ranges_count[font->faces_count] = ranges_count;
+	font->ft_faces[font->faces_count++] = face;
+	
+	return 1;
+
+}
+
+TEXTENGINEDEF void fontCloseFaces(Font* font){
+
+	for(int i = 0; i < font->faces_count; i++){
+		FT_Done_Face(font->ft_faces[i]);
+		if(font->faces_ranges[i]) TEXT_ENGINE_FREE(font->faces_ranges[i]);
+	}
+	font->faces_count = 0;
+	
+	FT_Done_FreeType(font->ft_library);
+
+}
+
+TEXTENGINEDEF void fontBeginUpload(Font* font){
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING,&font->application_pixel_buffer);
+	
+	//Orphan the storage of the last upload, so uploading never waits for the previous transfers
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,font->pixel_buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER,TEXT_ENGINE_UPLOAD_BUFFER_SIZE,0,GL_STREAM_DRAW);
+#endif
+
+}
+
+TEXTENGINEDEF int fontFindCharFace(Font* font, unsigned int c){
+
+	for(int k = 0; k < font->faces_count; k++){
+	
+		FontCharRange* ranges = font->faces_ranges[k];
+		int low = 0, high = font->faces_ranges_count[k] - 1;
+		
+		while(low <= high){
+			int middle = (low + high) / 2;
+			if(c < ranges[middle].first) high = middle - 1;
+			else if(c > ranges[middle].last) low = middle + 1;
+			else return k;
+		}
+		
+	}
+	
+	return -1;
+
+}
+
+TEXTENGINEDEF int fontLoadGlyph(Font* font, unsigned int c, Letter* letter, short* advance, int uploaded_bytes){
+
+	//First face that has the character, or the primary face to get its missing glyph
+	int face_index = fontFindCharFace(font,c);
+	FT_Face face = font->ft_faces[face_index < 0 ? 0 : face_index];
+	
+	FT_Load_Char(face,c,FT_LOAD_RENDER);
+	FT_GlyphSlot glyph = face->glyph;
+	
+	letter->left = glyph->bitmap_left;
+	letter->top = glyph->bitmap_top;
+	letter->width = glyph->bitmap.width;
+	letter->rows = glyph->bitmap.rows;
+	*advance = glyph->advance.x>>6;
+	if(c >= '0' && c <= '9' && font->digit_advance < *advance)
+		font->digit_advance = *advance;
+	
+	int bytes = letter->width * letter->rows;
+	if(bytes == 0) return 0;
+	
+	if(!fontPackGlyph(font,letter)){
+		letter->width = letter->rows = 0;
+		return 0;
+	}
+	
+	glBindTexture(GL_TEXTURE_2D,font->pages[letter->page]);
+	
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	if(uploaded_bytes + bytes <= TEXT_ENGINE_UPLOAD_BUFFER_SIZE){
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER,uploaded_bytes,bytes,glyph->bitmap.buffer);
+		glTexSubImage2D(GL_TEXTURE_2D,0,letter->x,letter->y,letter->width,letter->rows,GL_ALPHA,GL_UNSIGNED_BYTE,(void*)(size_t)uploaded_bytes);
+	}else{ //Bigger than what is left on the pixel buffer
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+		glTexSubImage2D(GL_TEXTURE_2D,0,letter->x,letter->y,letter->width,letter->rows,GL_ALPHA,GL_UNSIGNED_BYTE,glyph->bitmap.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER,font->pixel_buffer);
+	}
+#else
+	glTexSubImage2D(GL_TEXTURE_2D,0,letter->x,letter->y,letter->width,letter->rows,GL_ALPHA,GL_UNSIGNED_BYTE,glyph->bitmap.buffer);
+#endif
+	
+	return bytes;
+
+}
+
+TEXTENGINEDEF void fontEndUpload(Font* font){
+
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,font->application_pixel_buffer);
+#endif
+	glBindTexture(GL_TEXTURE_2D,0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+	
+	if(font->loaded_glyphs > 31){
+		font->tab_unit = font->letters[31].width;
+		font->tab_width = font->tab_unit * font->tab_size;
+	}
+
+}
+
+TEXTENGINEDEF FontGlyph* fontAddGlyph(Font* font, unsigned int c){
+
+	int face_index = fontFindCharFace(font,c);
+	FontGlyph* glyph = fontInsertGlyph(font,c);
+	
+	if(face_index < 0){
+		glyph->missing = 1;
+		glyph->advance = font->missing_glyph.advance;
+	}else{
+		FT_Face face = font->ft_faces[face_index];
+		FT_Load_Char(face,c,FT_LOAD_DEFAULT);
+		glyph->advance = face->glyph->advance.x>>6;
+	}
+	
+	return glyph;
+
+}
+
+TEXTENGINEDEF Letter* fontGetLetter(Font* font, unsigned int c, int* advance){
+
+	if(c < TEXT_ENGINE_MAX_GLYPHS_COUNT){
+		*advance = font->advances[c];
+		return &font->letters[c];
+	}
+	
+	FontGlyph* glyph = fontFindGlyph(font,c);
+	if(glyph->missing) glyph = &font->missing_glyph; //Rendered once for all the characters no face has
+	
+	if(!glyph->rendered){
+		//Usually in the middle of a draw, so the texture it has bound is bound again after the upload
+		int texture_binding;
+		glGetIntegerv(GL_TEXTURE_BINDING_2D,&texture_binding);
+		fontBeginUpload(font);
+		fontLoadGlyph(font,c,&glyph->letter,&glyph->advance,0);
+		fontEndUpload(font);
+		glBindTexture(GL_TEXTURE_2D,texture_binding);
+		glyph->rendered = 1;
+	}
+	
+	*advance = glyph->advance;
+	return &glyph->letter;
+
+}
+
+TEXTENGINEDEF int fontAddAtlasPage(Font* font){
+
+	if(font->pages_count >= TEXT_ENGINE_MAX_ATLAS_PAGES){
+		puts("Text Engine: Atlas pages limit reached, increase TEXT_ENGINE_MAX_ATLAS_PAGES");
+		return 0;
+	}
+	
+	//Page starts cleared, so the padding between glyphs never bleeds with linear filtering
+	unsigned char* pixels = (unsigned char*)TEXT_ENGINE_MALLOC(font->page_size * font->page_size);
+	memset(pixels,0,font->page_size * font->page_size);
+	
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	int pixel_buffer_binding;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING,&pixel_buffer_binding);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+#endif
+	
+	unsigned int* page = &font->pages[font->pages_count];
+	glGenTextures(1,page);
+	glBindTexture(GL_TEXTURE_2D,*page);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA,font->page_size,font->page_size,0,GL_ALPHA,GL_UNSIGNED_BYTE,pixels);
+	
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,pixel_buffer_binding);
+#endif
+	
+	TEXT_ENGINE_FREE(pixels);
+	
+	font->pages_count++;
+	font->pen_x = 1;
+	font->pen_y = 1;
+	font->shelf_height = 0;
+	
+	return 1;
+
+}
+
+TEXTENGINEDEF int fontPackGlyph(Font* font, Letter* letter){
+
+	if(letter->width + 2 > font->page_size || letter->rows + 2 > font->page_size)
+		return 0;
+	
+	if(font->pages_count > 0 && font->pen_x + letter->width + 1 > font->page_size){
+		font->pen_x = 1;
+		font->pen_y += font->shelf_height + 1;
+		font->shelf_height = 0;
+	}
+	
+	if(font->pages_count == 0 || font->pen_y + letter->rows + 1 > font->page_size){
+		if(!fontAddAtlasPage(font))
+			return 0;
+	}
+	
+	letter->page = font->pages_count - 1;
+	letter->x = font->pen_x;
+	letter->y = font->pen_y;
+	
+	font->pen_x += letter->width + 1;
+	if(font->shelf_height < letter->rows) font->shelf_height = letter->rows;
+	
+	return 1;
+
+}
+
+//============================== If Using Modern OpenGL ==============================
+
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+
+TEXTENGINEDEF Font* createFontAsync(const char* font_name, int size){
+
+	Font* font = (Font*)TEXT_ENGINE_MALLOC(sizeof(Font));
+	font->size = size;
+	font->tab_size = 4;
+	font->scale_x = 1.0f, font->scale_y = 1.0f;
+	float gl_current_view_port[4];
+	glGetFloatv(GL_VIEWPORT,gl_current_view_port);
+	font->canvas_width = gl_current_view_port[2];
+	font->canvas_height = gl_current_view_port[3];
+	font->canvas_depth = 1000000;
+	font->depth = 0.0;
+	font->color_r = 1.0f;
+	font->color_g = 1.0f;
+	font->color_b = 1.0f;
+	font->color_a = 1.0f;
+	font->free_transform = 0;
+	
+	for(int i = 0; i < 16; i++) font->projection_matrix[i] = 0.0f;
+	font->projection_matrix[0] = font->projection_matrix[5] = font->projection_matrix[10] = font->projection_matrix[15] = 1.0f;
+	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth,font->projection_matrix);
+	
+	for(int i = 0; i < 16; i++) font->transform_matrix[i] = 0.0f;
+	font->transform_matrix[0] = font->transform_matrix[5] = font->transform_matrix[10] = font->transform_matrix[15] = 1.0f;
+	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth,font->transform_matrix);
+	
+	if(!fontInitLoading(font,font_name,size)){
+		TEXT_ENGINE_FREE(font);
+		return 0;
+	}
+	
+	//Setting Shader
+	const char* vertex_shader_source = R"(
+	
+		#version 110
+		
 		attribute vec2 in_vertex;
 		attribute vec2 in_uv;
 		
@@ -270,11 +1263,12 @@ TEXTENGINEDEF Font* createFont(const char* font_name, int size){
 		
 		uniform vec3 position;
 		uniform vec2 size;
+		uniform vec4 uv_rect;
 		
 		varying vec2 out_uv;
 		
 		void main(){
-			out_uv = in_uv;
+			out_uv = uv_rect.xy + in_uv * uv_rect.zw;
 			gl_Position = projection * model * vec4( position.xy + (in_vertex * size) , position.z, 1.0);
 		}
 		
@@ -346,7 +1340,7 @@ TEXTENGINEDEF Font* createFont(const char* font_name, int size){
 	glGenVertexArrays(1,&font->vertex_array);
 	glBindVertexArray(font->vertex_array);
 	
-	unsigned int vbo[2];
+	unsigned int* vbo = font->vertex_buffers;
 	glGenBuffers(2,vbo);
 	glBindBuffer(GL_ARRAY_BUFFER,vbo[0]);
 	glBufferData(GL_ARRAY_BUFFER,sizeof(float)*12,vertex,GL_STATIC_DRAW);
@@ -364,7 +1358,20 @@ TEXTENGINEDEF Font* createFont(const char* font_name, int size){
 	return font;
 }
 
-TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y){
+typedef struct{
+
+	int x, initial_x, initial_y, line;
+	int bound_page;
+	float texel_size;
+	int position_location, size_location, uv_rect_location;
+	
+	//OpenGL state restored by fontEndTextPen
+	int is_gltexture2d_active, is_gldepthtest_active, gldepth_func, is_glblend_active;
+	int temp_gl_blend_src, temp_gl_blend_dst;
+
+}FontTextPen; //Text being drawn, so drawText and the formatted draws share the glyph loop
+
+TEXTENGINEDEF void fontBeginTextPen(Font* font, FontTextPen* pen, int x, int y){
 
 	glUseProgram(font->shader);
 	glBindVertexArray(font->vertex_array);
@@ -375,7 +1382,7 @@ TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y)
 	glUniform4f(glGetUniformLocation(font->shader,"color"),font->color_r,font->color_g,font->color_b,font->color_a);
 	
 	if(!font->free_transform){
-		float vector[3] = {x,y,0.0};
+		float vector[3] = {(float)x,(float)y,0.0f};
 		fontIdentityMatrix4x4(font->transform_matrix);
 		fontTranslateMatrix4x4(font->transform_matrix,vector);
 		vector[0] = font->scale_x, vector[1] = font->scale_y, vector[2] = 1.0;
@@ -385,62 +1392,421 @@ TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y)
 	}
 	glUniformMatrix4fv(glGetUniformLocation(font->shader,"model"),1,GL_FALSE,font->transform_matrix);
 	glUniformMatrix4fv(glGetUniformLocation(font->shader,"projection"),1,GL_FALSE,font->projection_matrix);
+	
+	pen->position_location = glGetUniformLocation(font->shader,"position");
+	pen->size_location = glGetUniformLocation(font->shader,"size");
+	pen->uv_rect_location = glGetUniformLocation(font->shader,"uv_rect");
 
-	int is_gltexture2d_active;
-	glGetIntegerv(GL_TEXTURE_2D,&is_gltexture2d_active);
-	if(!is_gltexture2d_active)
+	glGetIntegerv(GL_TEXTURE_2D,&pen->is_gltexture2d_active);
+	if(!pen->is_gltexture2d_active)
 		glEnable(GL_TEXTURE_2D);
 		
-	int is_gldepthtest_active;
-	glGetIntegerv(GL_DEPTH_TEST,&is_gldepthtest_active);
-	if(!is_gldepthtest_active)
+	glGetIntegerv(GL_DEPTH_TEST,&pen->is_gldepthtest_active);
+	if(!pen->is_gldepthtest_active)
 		glEnable(GL_DEPTH_TEST);
 	
-	int gldepth_func;
-	glGetIntegerv(GL_DEPTH_FUNC,&gldepth_func);
+	glGetIntegerv(GL_DEPTH_FUNC,&pen->gldepth_func);
 	glDepthFunc(GL_LEQUAL);
 		
-	int is_glblend_active;
-	glGetIntegerv(GL_BLEND,&is_glblend_active);
-	if(!is_glblend_active)
+	glGetIntegerv(GL_BLEND,&pen->is_glblend_active);
+	if(!pen->is_glblend_active)
 		glEnable(GL_BLEND);
 
-	int temp_gl_blend_src, temp_gl_blend_dst;
-	glGetIntegerv(GL_BLEND_SRC,&temp_gl_blend_src);
-	glGetIntegerv(GL_BLEND_DST,&temp_gl_blend_dst);
-	if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+	glGetIntegerv(GL_BLEND_SRC,&pen->temp_gl_blend_src);
+	glGetIntegerv(GL_BLEND_DST,&pen->temp_gl_blend_dst);
+	if(pen->temp_gl_blend_src != GL_SRC_ALPHA || pen->temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
 		glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 
-	int initial_x = x, initial_y = y, line = font->size;
+	pen->x = pen->initial_x = x;
+	pen->initial_y = y;
+	pen->line = font->size;
 	
-	for(unsigned int i = 0; i < strlen((char*)text); i++){
+	pen->texel_size = 1.0f / font->page_size;
+	pen->bound_page = -1;
+
+}
+
+TEXTENGINEDEF void fontPutTextPen(Font* font, FontTextPen* pen, unsigned int c){
+
+	if(c == '\n'){
 	
-		if(text[i] == '\n'){
+		pen->line += font->size;
+		pen->x = pen->initial_x;
 		
-			line += font->size;
-			x = initial_x;
-			
-		}else if(text[i] == '	'){
+	}else if(c == '	'){
+	
+		pen->x += font->tab_width;
 		
-			x += font->letters[31].width * font->tab_size;
-			
-		}else{
+	}else{
+	
+		int advance;
+		Letter* letter = fontGetLetter(font,c,&advance);
 		
-			y = line + (initial_y-font->letters[(int)text[i]].top);
+		if(letter->width){
+		
+			int y = pen->line + (pen->initial_y-letter->top);
+			float texel_size = pen->texel_size;
 			
-			glUniform3f(glGetUniformLocation(font->shader,"position"),x,y,font->depth);
-			glUniform2f(glGetUniformLocation(font->shader,"size"),font->letters[(int)text[i]].width,font->letters[(int)text[i]].rows);
-
-			glBindTexture(GL_TEXTURE_2D,font->letters[(int)text[i]].texture);
+			glUniform3f(pen->position_location,pen->x,y,font->depth);
+			glUniform2f(pen->size_location,letter->width,letter->rows);
+			glUniform4f(pen->uv_rect_location,letter->x*texel_size,letter->y*texel_size,letter->width*texel_size,letter->rows*texel_size);
+
+			if(pen->bound_page != letter->page){
+				pen->bound_page = letter->page;
+				glBindTexture(GL_TEXTURE_2D,font->pages[pen->bound_page]);
+			}
 			
 			glDrawArrays(GL_TRIANGLES,0,6);
 			
-			x += font->letters[(int)text[i]].advance>>6;
+		}
+		
+		pen->x += advance;
+		
+	}
+
+}
+
+TEXTENGINEDEF void fontEndTextPen(Font* font, FontTextPen* pen){
+
+	if(!pen->is_gldepthtest_active)
+		glDisable(GL_DEPTH_TEST);
+	
+	glDepthFunc(pen->gldepth_func);
+	
+	if(pen->temp_gl_blend_src != GL_SRC_ALPHA || pen->temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+		glBlendFunc(pen->temp_gl_blend_src,pen->temp_gl_blend_dst);
+	
+	if(!pen->is_gltexture2d_active)
+		glDisable(GL_TEXTURE_2D);
+	
+	if(!pen->is_glblend_active)
+		glDisable(GL_BLEND);
+	
+	glBindTexture(GL_TEXTURE_2D,0);
+	glBindVertexArray(0);
+	glUseProgram(0);
+
+}
+
+TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y){
+
+	if(font->metrics_only) return;
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_DRAW_TEXT,font)){
+		fontTraceInt(x);
+		fontTraceInt(y);
+		fontTraceString(text);
+	}
+#endif
+
+	FontTextPen pen;
+	fontBeginTextPen(font,&pen,x,y);
+	
+	for(const unsigned char* t = text; *t;)
+		fontPutTextPen(font,&pen,*t < 0x80 ? *t++ : fontDecodeUTF8(&t,4));
+	
+	fontEndTextPen(font,&pen);
+
+}
+
+TEXTENGINEDEF FontLabelBatch* createFontLabelBatch(Font* font){
+
+	if(font->metrics_only){
+		puts("Text Engine: Label batches can not be created for metrics fonts");
+		return 0;
+	}
+	
+	FontLabelBatch* batch = (FontLabelBatch*)TEXT_ENGINE_MALLOC(sizeof(FontLabelBatch));
+	batch->font = font;
+	batch->labels_count = batch->labels_capacity = 0;
+	batch->glyphs_count = batch->glyphs_capacity = 0;
+	batch->matrices = 0;
+	batch->vertices = 0;
+	batch->glyph_pages = 0;
+	batch->matrices_rows = 0;
+	for(int i = 0; i < TEXT_ENGINE_MAX_ATLAS_PAGES; i++) batch->page_glyphs[i] = 0;
+	
+	//Setting Shader, each glyph fetches the matrix of its label from a float texture (256 matrices per row)
+	const char* vertex_shader_source = R"(
+	
+		#version 130
+		
+		in vec3 in_position;
+		in vec2 in_uv;
+		in float in_label;
+		
+		uniform mat4 projection;
+		uniform sampler2D matrices;
+		
+		out vec2 out_uv;
+		
+		void main(){
+			int label = int(in_label);
+			ivec2 texel = ivec2((label - (label / 256) * 256) * 4, label / 256);
+			mat4 model = mat4(
+				texelFetch(matrices,texel,0),
+				texelFetch(matrices,texel + ivec2(1,0),0),
+				texelFetch(matrices,texel + ivec2(2,0),0),
+				texelFetch(matrices,texel + ivec2(3,0),0)
+			);
+			out_uv = in_uv;
+			gl_Position = projection * model * vec4(in_position, 1.0);
+		}
+		
+	)";
+	
+	const char* fragment_shader_source = R"(
+	
+		#version 130
+		
+		in vec2 out_uv;
+		
+		uniform sampler2D atlas;
+		uniform vec4 color;
+		
+		void main(){
+			float a = texture(atlas,out_uv).a;
+			if(a <= 0.0) discard;
+			gl_FragColor = color * a;
+		}
+		
+	)";
+	
+	unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex_shader,1,&vertex_shader_source,0);
+	glCompileShader(vertex_shader);
+	int success;
+	char infolog[512];
+	glGetShaderiv(vertex_shader,GL_COMPILE_STATUS,&success);
+	if(!success){
+		glGetShaderInfoLog(vertex_shader,512,0,infolog);
+		printf("Text Engine: Label batch creation error on create Vertex Shader: %s\n",infolog);
+	}
+	
+	unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment_shader,1,&fragment_shader_source,0);
+	glCompileShader(fragment_shader);
+	glGetShaderiv(fragment_shader,GL_COMPILE_STATUS,&success);
+	if(!success){
+		glGetShaderInfoLog(fragment_shader,512,0,infolog);
+		printf("Text Engine: Label batch creation error on create Fragment Shader: %s\n",infolog);
+	}
+	
+	batch->shader = glCreateProgram();
+	glAttachShader(batch->shader,vertex_shader);
+	glAttachShader(batch->shader,fragment_shader);
+	glBindAttribLocation(batch->shader,0,"in_position");
+	glBindAttribLocation(batch->shader,1,"in_uv");
+	glBindAttribLocation(batch->shader,2,"in_label");
+	glLinkProgram(batch->shader);
+	
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+	
+	//Setting Vertex Array
+	glGenVertexArrays(1,&batch->vertex_array);
+	glBindVertexArray(batch->vertex_array);
+	
+	glGenBuffers(1,&batch->vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER,batch->vertex_buffer);
+	glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(float)*6,0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,sizeof(float)*6,(void*)(sizeof(float)*3));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2,1,GL_FLOAT,GL_FALSE,sizeof(float)*6,(void*)(sizeof(float)*5));
+	glEnableVertexAttribArray(2);
+	
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	glBindVertexArray(0);
+	
+	//Setting Matrices Texture
+	glGenTextures(1,&batch->matrices_texture);
+	glBindTexture(GL_TEXTURE_2D,batch->matrices_texture);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D,0);
+	
+	return batch;
+	
+}
+
+TEXTENGINEDEF void addFontLabel(FontLabelBatch* batch, const unsigned char* text, float* transform, float depth){
+
+	Font* font = batch->font;
+	
+	if(batch->labels_count == batch->labels_capacity){
+		batch->labels_capacity = batch->labels_capacity ? batch->labels_capacity * 2 : 256;
+		batch->matrices = (float*)TEXT_ENGINE_REALLOC(batch->matrices,sizeof(float)*16*batch->labels_capacity);
+	}
+	
+	int label = batch->labels_count++;
+	memcpy(batch->matrices + label * 16,transform,sizeof(float)*16);
+	
+	float texel_size = 1.0f / font->page_size;
+	int x = 0, line = font->size;
+	
+	for(const unsigned char* t = text; *t;){
+	
+		unsigned int c = *t < 0x80 ? *t++ : fontDecodeUTF8(&t,4);
+		
+		if(c == '\n'){
+		
+			line += font->size;
+			x = 0;
+			
+		}else if(c == '	'){
+		
+			x += font->tab_width;
+			
+		}else{
+		
+			int advance;
+			Letter* letter = fontGetLetter(font,c,&advance);
+			
+			if(letter->width){
+			
+				if(batch->glyphs_count == batch->glyphs_capacity){
+					batch->glyphs_capacity = batch->glyphs_capacity ? batch->glyphs_capacity * 2 : 1024;
+					batch->vertices = (float*)TEXT_ENGINE_REALLOC(batch->vertices,sizeof(float)*36*batch->glyphs_capacity);
+					batch->glyph_pages = (unsigned short*)TEXT_ENGINE_REALLOC(batch->glyph_pages,sizeof(unsigned short)*batch->glyphs_capacity);
+				}
+				
+				float x0 = x * font->scale_x, y0 = (line - letter->top) * font->scale_y;
+				float x1 = x0 + letter->width * font->scale_x, y1 = y0 + letter->rows * font->scale_y;
+				float u0 = letter->x * texel_size, v0 = letter->y * texel_size;
+				float u1 = (letter->x + letter->width) * texel_size, v1 = (letter->y + letter->rows) * texel_size;
+				
+				float quad[6][4] = {
+					{x0,y0,u0,v0},
+					{x0,y1,u0,v1},
+					{x1,y0,u1,v0},
+					{x1,y0,u1,v0},
+					{x0,y1,u0,v1},
+					{x1,y1,u1,v1}
+				};
+				
+				float* vertex = batch->vertices + batch->glyphs_count * 36;
+				for(int k = 0; k < 6; k++, vertex += 6){
+					vertex[0] = quad[k][0];
+					vertex[1] = quad[k][1];
+					vertex[2] = depth;
+					vertex[3] = quad[k][2];
+					vertex[4] = quad[k][3];
+					vertex[5] = label;
+				}
+				
+				batch->glyph_pages[batch->glyphs_count++] = letter->page;
+				batch->page_glyphs[letter->page]++;
+				
+			}
+			
+			x += advance;
 			
 		}
 		
 	}
 	
+}
+
+TEXTENGINEDEF void clearFontLabelBatch(FontLabelBatch* batch){
+
+	batch->labels_count = 0;
+	batch->glyphs_count = 0;
+	for(int i = 0; i < TEXT_ENGINE_MAX_ATLAS_PAGES; i++) batch->page_glyphs[i] = 0;
+	
+}
+
+TEXTENGINEDEF void drawFontLabelBatch(FontLabelBatch* batch){
+
+	if(!batch->glyphs_count) return;
+	
+	Font* font = batch->font;
+	
+	//Upload matrices, full rows first and then what is left on the last row
+	int rows = (batch->labels_count + 255) / 256;
+	int full_rows = batch->labels_count / 256, rest = batch->labels_count - full_rows * 256;
+	
+	int pixel_buffer_binding;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING,&pixel_buffer_binding);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+	
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D,batch->matrices_texture);
+	if(rows > batch->matrices_rows){
+		batch->matrices_rows = rows;
+		glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA32F,1024,rows,0,GL_RGBA,GL_FLOAT,0);
+	}
+	if(full_rows)
+		glTexSubImage2D(GL_TEXTURE_2D,0,0,0,1024,full_rows,GL_RGBA,GL_FLOAT,batch->matrices);
+	if(rest)
+		glTexSubImage2D(GL_TEXTURE_2D,0,0,full_rows,rest*4,1,GL_RGBA,GL_FLOAT,batch->matrices + full_rows * 256 * 16);
+	
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,pixel_buffer_binding);
+	
+	//Group glyphs by atlas page (counting sort) when more than one page is used
+	float* vertices = batch->vertices;
+	int page_first[TEXT_ENGINE_MAX_ATLAS_PAGES];
+	int pages_used = 0;
+	for(int i = 0, first = 0; i < TEXT_ENGINE_MAX_ATLAS_PAGES; i++){
+		page_first[i] = first;
+		first += batch->page_glyphs[i];
+		if(batch->page_glyphs[i]) pages_used++;
+	}
+	
+	FontFrameMark frame_mark = fontGetFrameMark();
+	
+	if(pages_used > 1){
+		float* sorted_vertices = (float*)fontFrameAlloc(sizeof(float)*36*batch->glyphs_count);
+		int page_cursor[TEXT_ENGINE_MAX_ATLAS_PAGES];
+		memcpy(page_cursor,page_first,sizeof(page_first));
+		for(int i = 0; i < batch->glyphs_count; i++)
+			memcpy(sorted_vertices + (page_cursor[batch->glyph_pages[i]]++) * 36,batch->vertices + i * 36,sizeof(float)*36);
+		vertices = sorted_vertices;
+	}
+	
+	glUseProgram(batch->shader);
+	glBindVertexArray(batch->vertex_array);
+	
+	glBindBuffer(GL_ARRAY_BUFFER,batch->vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER,sizeof(float)*36*batch->glyphs_count,vertices,GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER,0);
+	
+	fontReleaseFrameMark(frame_mark);
+	
+	glUniform1i(glGetUniformLocation(batch->shader,"matrices"),1);
+	glUniform1i(glGetUniformLocation(batch->shader,"atlas"),0);
+	glUniform4f(glGetUniformLocation(batch->shader,"color"),font->color_r,font->color_g,font->color_b,font->color_a);
+	glUniformMatrix4fv(glGetUniformLocation(batch->shader,"projection"),1,GL_FALSE,font->projection_matrix);
+	
+	int is_gldepthtest_active;
+	glGetIntegerv(GL_DEPTH_TEST,&is_gldepthtest_active);
+	if(!is_gldepthtest_active)
+		glEnable(GL_DEPTH_TEST);
+	
+	int gldepth_func;
+	glGetIntegerv(GL_DEPTH_FUNC,&gldepth_func);
+	glDepthFunc(GL_LEQUAL);
+		
+	int is_glblend_active;
+	glGetIntegerv(GL_BLEND,&is_glblend_active);
+	if(!is_glblend_active)
+		glEnable(GL_BLEND);
+
+	int temp_gl_blend_src, temp_gl_blend_dst;
+	glGetIntegerv(GL_BLEND_SRC,&temp_gl_blend_src);
+	glGetIntegerv(GL_BLEND_DST,&temp_gl_blend_dst);
+	if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+		glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+	
+	glActiveTexture(GL_TEXTURE0);
+	
+	for(int i = 0; i < TEXT_ENGINE_MAX_ATLAS_PAGES; i++){
+		if(!batch->page_glyphs[i]) continue;
+		glBindTexture(GL_TEXTURE_2D,font->pages[i]);
+		glDrawArrays(GL_TRIANGLES,page_first[i] * 6,batch->page_glyphs[i] * 6);
+	}
+	
 	if(!is_gldepthtest_active)
 		glDisable(GL_DEPTH_TEST);
 	
@@ -449,15 +1815,348 @@ TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y)
 	if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
 		glBlendFunc(temp_gl_blend_src,temp_gl_blend_dst);
 	
-	if(!is_gltexture2d_active)
-		glDisable(GL_TEXTURE_2D);
-	
 	if(!is_glblend_active)
 		glDisable(GL_BLEND);
 	
 	glBindTexture(GL_TEXTURE_2D,0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D,0);
+	glActiveTexture(GL_TEXTURE0);
 	glBindVertexArray(0);
 	glUseProgram(0);
+	
+}
+
+TEXTENGINEDEF void deleteFontLabelBatch(FontLabelBatch* batch){
+
+	glDeleteTextures(1,&batch->matrices_texture);
+	glDeleteBuffers(1,&batch->vertex_buffer);
+	glDeleteVertexArrays(1,&batch->vertex_array);
+	glDeleteProgram(batch->shader);
+	
+	TEXT_ENGINE_FREE(batch->matrices);
+	TEXT_ENGINE_FREE(batch->vertices);
+	TEXT_ENGINE_FREE(batch->glyph_pages);
+	TEXT_ENGINE_FREE(batch);
+	
+}
+
+static struct{
+
+	FontCachedText entries[TEXT_ENGINE_TEXT_CACHE_ENTRIES];
+	int entries_count;
+	size_t used_bytes;
+	unsigned int framebuffer;
+	unsigned int uses; //Stamped on the entries when drawn, the lowest last_use is the least recently drawn
+
+}font_text_cache;
+
+TEXTENGINEDEF FontCachedText* fontCacheText(Font* font, const unsigned char* text){
+
+	unsigned int hash = 2166136261u;
+	int length = 0;
+	for(; text[length]; length++)
+		hash = (hash ^ text[length]) * 16777619u;
+	
+	for(int i = 0; i < font_text_cache.entries_count; i++){
+	
+		FontCachedText* cached = &font_text_cache.entries[i];
+		
+		if(cached->font != font || cached->hash != hash || cached->length != length || memcmp(cached->text,text,length))
+			continue;
+		
+		if(cached->scale_x == font->scale_x && cached->scale_y == font->scale_y && cached->tab_width == font->tab_width &&
+		   cached->loaded_glyphs == font->loaded_glyphs && cached->faces_count == font->faces_count){
+			cached->last_use = ++font_text_cache.uses;
+			return cached;
+		}
+		
+		fontEvictCachedText(i); //Stale, rendered again below
+		break;
+		
+	}
+	
+	//Bounds of the glyphs, laid out as drawText does
+	int left = 1 << 30, top = 1 << 30, right = -(1 << 30), bottom = -(1 << 30);
+	int x = 0, line = font->size;
+	
+	for(const unsigned char* t = text; *t;){
+	
+		unsigned int c = *t < 0x80 ? *t++ : fontDecodeUTF8(&t,4);
+		
+		if(c == '\n'){
+			line += font->size;
+			x = 0;
+		}else if(c == '	'){
+			x += font->tab_width;
+		}else{
+			int advance;
+			Letter* letter = fontGetLetter(font,c,&advance);
+			if(letter->width){
+				int y = line - letter->top;
+				if(left > x) left = x;
+				if(top > y) top = y;
+				if(right < x + letter->width) right = x + letter->width;
+				if(bottom < y + letter->rows) bottom = y + letter->rows;
+			}
+			x += advance;
+		}
+		
+	}
+	
+	if(right <= left) return 0; //Nothing visible
+	
+	int texture_width = ceilf((right - left) * font->scale_x);
+	int texture_height = ceilf((bottom - top) * font->scale_y);
+	size_t bytes = (size_t)texture_width * texture_height;
+	
+	int max_texture_size;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE,&max_texture_size);
+	if(texture_width <= 0 || texture_height <= 0 || texture_width > max_texture_size || texture_height > max_texture_size || bytes > TEXT_ENGINE_TEXT_CACHE_SIZE)
+		return 0;
+	
+	//Drop the least recently drawn texts until the new one fits
+	while(font_text_cache.entries_count &&
+	     (font_text_cache.entries_count >= TEXT_ENGINE_TEXT_CACHE_ENTRIES || font_text_cache.used_bytes + bytes > TEXT_ENGINE_TEXT_CACHE_SIZE)){
+		int oldest = 0;
+		for(int i = 1; i < font_text_cache.entries_count; i++)
+			if(font_text_cache.entries[i].last_use < font_text_cache.entries[oldest].last_use)
+				oldest = i;
+		fontEvictCachedText(oldest);
+	}
+	
+	FontCachedText* cached = &font_text_cache.entries[font_text_cache.entries_count++];
+	cached->font = font;
+	cached->text = (unsigned char*)TEXT_ENGINE_MALLOC(length + 1);
+	memcpy(cached->text,text,length + 1);
+	cached->length = length;
+	cached->hash = hash;
+	cached->scale_x = font->scale_x;
+	cached->scale_y = font->scale_y;
+	cached->tab_width = font->tab_width;
+	cached->loaded_glyphs = font->loaded_glyphs;
+	cached->faces_count = font->faces_count;
+	cached->left = left, cached->top = top, cached->right = right, cached->bottom = bottom;
+	cached->texture_width = texture_width;
+	cached->texture_height = texture_height;
+	cached->last_use = ++font_text_cache.uses;
+	font_text_cache.used_bytes += bytes;
+	
+	int pixel_buffer_binding;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING,&pixel_buffer_binding);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,0);
+	
+	//Single channel texture, read as alpha by the font shader
+	glGenTextures(1,&cached->texture);
+	glBindTexture(GL_TEXTURE_2D,cached->texture);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_SWIZZLE_A,GL_RED);
+	glTexImage2D(GL_TEXTURE_2D,0,GL_R8,texture_width,texture_height,0,GL_RED,GL_UNSIGNED_BYTE,0);
+	glBindTexture(GL_TEXTURE_2D,0);
+	
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER,pixel_buffer_binding);
+	
+	fontRenderCachedText(font,cached,text);
+	
+	return cached;
+
+}
+
+TEXTENGINEDEF void fontRenderCachedText(Font* font, FontCachedText* cached, const unsigned char* text){
+
+	int draw_framebuffer, read_framebuffer, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING,&draw_framebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING,&read_framebuffer);
+	glGetIntegerv(GL_VIEWPORT,viewport);
+	
+	float clear_color[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE,clear_color);
+	
+	int blend_equation_rgb, blend_equation_alpha;
+	glGetIntegerv(GL_BLEND_EQUATION_RGB,&blend_equation_rgb);
+	glGetIntegerv(GL_BLEND_EQUATION_ALPHA,&blend_equation_alpha);
+	
+	int is_glscissortest_active;
+	glGetIntegerv(GL_SCISSOR_TEST,&is_glscissortest_active);
+	if(is_glscissortest_active)
+		glDisable(GL_SCISSOR_TEST);
+	
+	if(!font_text_cache.framebuffer)
+		glGenFramebuffers(1,&font_text_cache.framebuffer);
+	
+	glBindFramebuffer(GL_FRAMEBUFFER,font_text_cache.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER,GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D,cached->texture,0);
+	glViewport(0,0,cached->texture_width,cached->texture_height);
+	glClearColor(0.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	//Glyph boxes overlap, so coverage is merged with max instead of blended
+	glBlendEquation(GL_MAX);
+	
+	float transform_matrix[16], projection_matrix[16];
+	memcpy(transform_matrix,font->transform_matrix,sizeof(transform_matrix));
+	memcpy(projection_matrix,font->projection_matrix,sizeof(projection_matrix));
+	int free_transform = font->free_transform;
+	float depth = font->depth;
+	float color[4] = {font->color_r,font->color_g,font->color_b,font->color_a};
+	
+	//Bounds are scaled to the texture, with its first row being the top of the text
+	float vector[3] = {font->scale_x,font->scale_y,1.0f};
+	fontIdentityMatrix4x4(font->transform_matrix);
+	fontScaleMatrix4x4(font->transform_matrix,vector);
+	vector[0] = -cached->left, vector[1] = -cached->top, vector[2] = 0.0f;
+	fontTranslateMatrix4x4(font->transform_matrix,vector);
+	
+	for(int i = 0; i < 16; i++) font->projection_matrix[i] = 0.0f;
+	fontCreateOrthographicMatrix(0,cached->texture_width,0,cached->texture_height,-font->canvas_depth,font->canvas_depth,font->projection_matrix);
+	
+	font->free_transform = 1;
+	font->depth = 0.0f;
+	font->color_r = font->color_g = font->color_b = font->color_a = 1.0f;
+	
+	drawText(font,text,0,0);
+	
+	memcpy(font->transform_matrix,transform_matrix,sizeof(transform_matrix));
+	memcpy(font->projection_matrix,projection_matrix,sizeof(projection_matrix));
+	font->free_transform = free_transform;
+	font->depth = depth;
+	font->color_r = color[0], font->color_g = color[1], font->color_b = color[2], font->color_a = color[3];
+	
+	glBlendEquationSeparate(blend_equation_rgb,blend_equation_alpha);
+	glClearColor(clear_color[0],clear_color[1],clear_color[2],clear_color[3]);
+	glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER,draw_framebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER,read_framebuffer);
+	
+	if(is_glscissortest_active)
+		glEnable(GL_SCISSOR_TEST);
+
+}
+
+TEXTENGINEDEF void fontEvictCachedText(int index){
+
+	FontCachedText* cached = &font_text_cache.entries[index];
+	
+	glDeleteTextures(1,&cached->texture);
+	TEXT_ENGINE_FREE(cached->text);
+	font_text_cache.used_bytes -= (size_t)cached->texture_width * cached->texture_height;
+	
+	*cached = font_text_cache.entries[--font_text_cache.entries_count];
+
+}
+
+TEXTENGINEDEF void fontDeleteCachedTexts(Font* font){
+
+	for(int i = font_text_cache.entries_count - 1; i >= 0; i--)
+		if(!font || font_text_cache.entries[i].font == font)
+			fontEvictCachedText(i);
+
+}
+
+TEXTENGINEDEF void drawCachedText(Font* font, const unsigned char* text, int x, int y){
+
+	if(font->metrics_only) return;
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_DRAW_CACHED_TEXT,font)){
+		fontTraceInt(x);
+		fontTraceInt(y);
+		fontTraceString(text);
+	}
+	FILE* trace_file = font_trace_file; //The drawText calls made from here are part of this record
+	font_trace_file = 0;
+#endif
+
+	FontCachedText* cached = fontCacheText(font,text);
+	
+	if(!cached){
+	
+		drawText(font,text,x,y);
+		
+	}else{
+	
+		glUseProgram(font->shader);
+		glBindVertexArray(font->vertex_array);
+		
+		glActiveTexture(GL_TEXTURE0);
+		glUniform1i(glGetUniformLocation(font->shader,"texture"),0);
+		glBindTexture(GL_TEXTURE_2D,cached->texture);
+		
+		glUniform4f(glGetUniformLocation(font->shader,"color"),font->color_r,font->color_g,font->color_b,font->color_a);
+		
+		//Same model matrix as drawText, so the quad lands where the glyphs would
+		if(!font->free_transform){
+			float vector[3] = {(float)x,(float)y,0.0f};
+			fontIdentityMatrix4x4(font->transform_matrix);
+			fontTranslateMatrix4x4(font->transform_matrix,vector);
+			vector[0] = font->scale_x, vector[1] = font->scale_y, vector[2] = 1.0f;
+			fontScaleMatrix4x4(font->transform_matrix,vector);
+			vector[0] = -x, vector[1] = -y, vector[2] = 0.0f;
+			fontTranslateMatrix4x4(font->transform_matrix,vector);
+		}
+		glUniformMatrix4fv(glGetUniformLocation(font->shader,"model"),1,GL_FALSE,font->transform_matrix);
+		glUniformMatrix4fv(glGetUniformLocation(font->shader,"projection"),1,GL_FALSE,font->projection_matrix);
+		
+		glUniform3f(glGetUniformLocation(font->shader,"position"),x + cached->left,y + cached->top,font->depth);
+		glUniform2f(glGetUniformLocation(font->shader,"size"),cached->right - cached->left,cached->bottom - cached->top);
+		glUniform4f(glGetUniformLocation(font->shader,"uv_rect"),0.0f,0.0f,1.0f,1.0f);
+		
+		int is_gldepthtest_active;
+		glGetIntegerv(GL_DEPTH_TEST,&is_gldepthtest_active);
+		if(!is_gldepthtest_active)
+			glEnable(GL_DEPTH_TEST);
+		
+		int gldepth_func;
+		glGetIntegerv(GL_DEPTH_FUNC,&gldepth_func);
+		glDepthFunc(GL_LEQUAL);
+		
+		int is_glblend_active;
+		glGetIntegerv(GL_BLEND,&is_glblend_active);
+		if(!is_glblend_active)
+			glEnable(GL_BLEND);
+		
+		int temp_gl_blend_src, temp_gl_blend_dst;
+		glGetIntegerv(GL_BLEND_SRC,&temp_gl_blend_src);
+		glGetIntegerv(GL_BLEND_DST,&temp_gl_blend_dst);
+		if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+			glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+		
+		glDrawArrays(GL_TRIANGLES,0,6);
+		
+		if(!is_gldepthtest_active)
+			glDisable(GL_DEPTH_TEST);
+		
+		glDepthFunc(gldepth_func);
+		
+		if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+			glBlendFunc(temp_gl_blend_src,temp_gl_blend_dst);
+		
+		if(!is_glblend_active)
+			glDisable(GL_BLEND);
+		
+		glBindTexture(GL_TEXTURE_2D,0);
+		glBindVertexArray(0);
+		glUseProgram(0);
+		
+	}
+	
+#ifdef TEXT_ENGINE_TRACE
+	font_trace_file = trace_file;
+#endif
+
+}
+
+TEXTENGINEDEF void deleteFontTextCache(){
+
+	fontDeleteCachedTexts(0);
+	
+	if(font_text_cache.framebuffer){
+		glDeleteFramebuffers(1,&font_text_cache.framebuffer);
+		font_text_cache.framebuffer = 0;
+	}
 
 }
 
@@ -465,9 +2164,60 @@ TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y)
 
 //============================== If Using OpenGL Compatibility Mode (Imediate Mode) ==============================
 
-TEXTENGINEDEF Font* createFont(const char* font_name, int size){
+typedef struct{
+
+	int page, glyphs_count;
+	float color[4];
+	float vertices[TEXT_ENGINE_BATCH_GLYPHS*12];
+	float uvs[TEXT_ENGINE_BATCH_GLYPHS*8];
+	float colors[TEXT_ENGINE_BATCH_GLYPHS*16];
+
+}FontGlyphArrays; //Client side arrays with the quads of the glyphs, drawn with one glDrawArrays per atlas page
 
-	Font* font = (Font*)malloc(sizeof(Font));
+TEXTENGINEDEF void fontFlushGlyphArrays(Font* font, FontGlyphArrays* arrays){
+
+	if(!arrays->glyphs_count) return;
+	
+	glBindTexture(GL_TEXTURE_2D,font->pages[arrays->page]);
+	glDrawArrays(GL_QUADS,0,arrays->glyphs_count*4);
+	
+	arrays->glyphs_count = 0;
+
+}
+
+TEXTENGINEDEF void fontPushGlyphArrays(Font* font, FontGlyphArrays* arrays, Letter* letter, int x, int y){
+
+	if(arrays->glyphs_count == TEXT_ENGINE_BATCH_GLYPHS || (arrays->glyphs_count && arrays->page != letter->page))
+		fontFlushGlyphArrays(font,arrays);
+	
+	arrays->page = letter->page;
+	
+	float texel_size = 1.0f / font->page_size;
+	float u0 = letter->x * texel_size, v0 = letter->y * texel_size;
+	float u1 = (letter->x + letter->width) * texel_size, v1 = (letter->y + letter->rows) * texel_size;
+	
+	float* vertex = arrays->vertices + arrays->glyphs_count * 12;
+	vertex[0] = x, vertex[1] = y, vertex[2] = font->depth;
+	vertex[3] = x, vertex[4] = y + letter->rows, vertex[5] = font->depth;
+	vertex[6] = x + letter->width, vertex[7] = y + letter->rows, vertex[8] = font->depth;
+	vertex[9] = x + letter->width, vertex[10] = y, vertex[11] = font->depth;
+	
+	float* uv = arrays->uvs + arrays->glyphs_count * 8;
+	uv[0] = u0, uv[1] = v0;
+	uv[2] = u0, uv[3] = v1;
+	uv[4] = u1, uv[5] = v1;
+	uv[6] = u1, uv[7] = v0;
+	
+	float* color = arrays->colors + arrays->glyphs_count * 16;
+	for(int i = 0; i < 16; i++) color[i] = arrays->color[i&3];
+	
+	arrays->glyphs_count++;
+
+}
+
+TEXTENGINEDEF Font* createFontAsync(const char* font_name, int size){
+
+	Font* font = (Font*)TEXT_ENGINE_MALLOC(sizeof(Font));
 	font->size = size;
 	font->tab_size = 4;
 	font->scale_x = 1.0f, font->scale_y = 1.0f;
@@ -487,95 +2237,83 @@ TEXTENGINEDEF Font* createFont(const char* font_name, int size){
 	font->projection_matrix[0] = font->projection_matrix[5] = font->projection_matrix[10] = font->projection_matrix[15] = 1.0f;
 	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-1.0,1.0,font->projection_matrix);
 	
-	FT_Library ft;
-	if( FT_Init_FreeType(&ft) ){
-		puts("Text Engine: Failed to init FreeType2 Library");
-		return 0;
-	}
-	FT_Face face;
-	if( FT_New_Face(ft,font_name,0,&face) ){
-		printf("Text Engine: Failed to load font: %s\n",font_name);
+	if(!fontInitLoading(font,font_name,size)){
+		TEXT_ENGINE_FREE(font);
 		return 0;
 	}
-	FT_Set_Pixel_Sizes(face,0,size);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-
-	for(int i = 0; i < TEXT_ENGINE_MAX_GLYPHS_COUNT; i++){
-	
-		FT_Load_Char(face,i,FT_LOAD_RENDER);
-		
-		glGenTextures(1,&font->letters[i].texture);
-		glBindTexture(GL_TEXTURE_2D,font->letters[i].texture);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_2D,0,GL_ALPHA,face->glyph->bitmap.width,face->glyph->bitmap.rows,0,GL_ALPHA,GL_UNSIGNED_BYTE,face->glyph->bitmap.buffer);
-		glBindTexture(GL_TEXTURE_2D,0);
-		
-		font->letters[i].left = face->glyph->bitmap_left;
-		font->letters[i].top = face->glyph->bitmap_top;
-		font->letters[i].width = face->glyph->bitmap.width;
-		font->letters[i].rows = face->glyph->bitmap.rows;
-		font->letters[i].advance = face->glyph->advance.x;
-		
-	}
-
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 	return font;
 }
 
-TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y){
+typedef struct{
 
+	int x, initial_x, initial_y, line;
+	FontGlyphArrays arrays;
+	
+	//OpenGL state restored by fontEndTextPen
 	int matrix_mode;
-	glGetIntegerv(GL_MATRIX_MODE,&matrix_mode);
-	glMatrixMode(GL_PROJECTION);
 	float gl_current_ortho[16];
-	glGetFloatv(GL_PROJECTION_MATRIX,gl_current_ortho);
+	int is_gltexture2d_active, is_gldepthtest_active, gldepth_func;
+	int is_glalphatest_active, glalpha_func, is_glblend_active;
+	int temp_gl_blend_src, temp_gl_blend_dst;
+	float old_color[4];
+
+}FontTextPen; //Text being drawn, so drawText and the formatted draws share the glyph loop
+
+TEXTENGINEDEF void fontBeginTextPen(Font* font, FontTextPen* pen, int x, int y){
+
+	glGetIntegerv(GL_MATRIX_MODE,&pen->matrix_mode);
+	glMatrixMode(GL_PROJECTION);
+	glGetFloatv(GL_PROJECTION_MATRIX,pen->gl_current_ortho);
 	glLoadIdentity();
 	glOrtho(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth);
 	glMatrixMode(GL_MODELVIEW);
 
-	int is_gltexture2d_active;
-	glGetIntegerv(GL_TEXTURE_2D,&is_gltexture2d_active);
-	if(!is_gltexture2d_active)
+	glGetIntegerv(GL_TEXTURE_2D,&pen->is_gltexture2d_active);
+	if(!pen->is_gltexture2d_active)
 		glEnable(GL_TEXTURE_2D);
 		
-	int is_gldepthtest_active;
-	glGetIntegerv(GL_DEPTH_TEST,&is_gldepthtest_active);
-	if(!is_gldepthtest_active)
+	glGetIntegerv(GL_DEPTH_TEST,&pen->is_gldepthtest_active);
+	if(!pen->is_gldepthtest_active)
 		glEnable(GL_DEPTH_TEST);
 	
-	int gldepth_func;
-	glGetIntegerv(GL_DEPTH_FUNC,&gldepth_func);
+	glGetIntegerv(GL_DEPTH_FUNC,&pen->gldepth_func);
 	glDepthFunc(GL_LEQUAL);
 	
-	int is_glalphatest_active;
-	glGetIntegerv(GL_ALPHA_TEST, &is_glalphatest_active);
-	if(!is_glalphatest_active)
+	glGetIntegerv(GL_ALPHA_TEST, &pen->is_glalphatest_active);
+	if(!pen->is_glalphatest_active)
 		glEnable(GL_ALPHA_TEST);
 	
-	int glalpha_func;
-	glGetIntegerv(GL_ALPHA_TEST_FUNC, &glalpha_func);
+	glGetIntegerv(GL_ALPHA_TEST_FUNC, &pen->glalpha_func);
 	glAlphaFunc(GL_GREATER, 0.0);
 		
-	int is_glblend_active;
-	glGetIntegerv(GL_BLEND,&is_glblend_active);
-	if(!is_glblend_active)
+	glGetIntegerv(GL_BLEND,&pen->is_glblend_active);
+	if(!pen->is_glblend_active)
 		glEnable(GL_BLEND);
 
-	int temp_gl_blend_src, temp_gl_blend_dst;
-	glGetIntegerv(GL_BLEND_SRC,&temp_gl_blend_src);
-	glGetIntegerv(GL_BLEND_DST,&temp_gl_blend_dst);
-	if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+	glGetIntegerv(GL_BLEND_SRC,&pen->temp_gl_blend_src);
+	glGetIntegerv(GL_BLEND_DST,&pen->temp_gl_blend_dst);
+	if(pen->temp_gl_blend_src != GL_SRC_ALPHA || pen->temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
 		glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 		
-	float old_color[4];
-	glGetFloatv(GL_CURRENT_COLOR,old_color);
-	glColor4f(font->color_r,font->color_g,font->color_b,font->color_a);
+	glGetFloatv(GL_CURRENT_COLOR,pen->old_color);
+	
+	FontGlyphArrays* arrays = &pen->arrays;
+	arrays->glyphs_count = 0;
+	arrays->color[0] = font->color_r, arrays->color[1] = font->color_g;
+	arrays->color[2] = font->color_b, arrays->color[3] = font->color_a;
+	
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3,GL_FLOAT,0,arrays->vertices);
+	glTexCoordPointer(2,GL_FLOAT,0,arrays->uvs);
+	glColorPointer(4,GL_FLOAT,0,arrays->colors);
 
-	int initial_x = x, initial_y = y, line = font->size;
+	pen->x = pen->initial_x = x;
+	pen->initial_y = y;
+	pen->line = font->size;
 	
 	glPushMatrix();
 	
@@ -585,73 +2323,280 @@ TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y)
 		glScalef(font->scale_x,font->scale_y,1.0);
 		glTranslatef(-x,-y,0);
 	}
+
+}
+
+TEXTENGINEDEF void fontPutTextPen(Font* font, FontTextPen* pen, unsigned int c){
+
+	if(c == '\n'){
 	
-	for(unsigned int i = 0; i < strlen((char*)text); i++){
+		pen->line += font->size;
+		pen->x = pen->initial_x;
+		
+	}else if(c == '	'){
 	
-		if(text[i] == '\n'){
+		pen->x += font->tab_width;
 		
-			line += font->size;
-			x = initial_x;
-			
-		}else if(text[i] == '	'){
+	}else{
+	
+		int advance;
+		Letter* letter = fontGetLetter(font,c,&advance);
 		
-			x += font->letters[31].width * font->tab_size;
-			
-		}else{
+		if(letter->width)
+			fontPushGlyphArrays(font,&pen->arrays,letter,pen->x,pen->line + (pen->initial_y-letter->top));
 		
-			y = line + (initial_y-font->letters[(int)text[i]].top);
-			
-			glBindTexture(GL_TEXTURE_2D,font->letters[(int)text[i]].texture);
-			glBegin(GL_QUADS);
-				glTexCoord2f(0,0);
-				glVertex3i(x, y, font->depth);
-				glTexCoord2f(0,1);
-				glVertex3i(x, y+font->letters[(int)text[i]].rows, font->depth);
-				glTexCoord2f(1,1);
-				glVertex3i(x+font->letters[(int)text[i]].width, y+font->letters[(int)text[i]].rows, font->depth);
-				glTexCoord2f(1,0);
-				glVertex3i(x+font->letters[(int)text[i]].width, y, font->depth);
-			glEnd();
-			glBindTexture(GL_TEXTURE_2D,0);
-			
-			x += font->letters[(int)text[i]].advance>>6;
-			
+		pen->x += advance;
+		
+	}
+
+}
+
+TEXTENGINEDEF void fontEndTextPen(Font* font, FontTextPen* pen){
+
+	fontFlushGlyphArrays(font,&pen->arrays);
+	glBindTexture(GL_TEXTURE_2D,0);
+	
+	glPopMatrix();
+	
+	glPopClientAttrib();
+	
+	glColor4f(pen->old_color[0], pen->old_color[1], pen->old_color[2], pen->old_color[3]);
+	
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(pen->gl_current_ortho);
+	glMatrixMode(pen->matrix_mode);
+	
+	if(!pen->is_gldepthtest_active)
+		glDisable(GL_DEPTH_TEST);
+	
+	glDepthFunc(pen->gldepth_func);
+	
+	if(!pen->is_glalphatest_active)
+		glDisable(GL_ALPHA_TEST);
+		
+	glAlphaFunc(pen->glalpha_func, 0.0);
+	
+	if(pen->temp_gl_blend_src != GL_SRC_ALPHA || pen->temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
+		glBlendFunc(pen->temp_gl_blend_src,pen->temp_gl_blend_dst);
+	
+	if(!pen->is_gltexture2d_active)
+		glDisable(GL_TEXTURE_2D);
+	
+	if(!pen->is_glblend_active)
+		glDisable(GL_BLEND);
+
+}
+
+TEXTENGINEDEF void drawText(Font* font, const unsigned char* text, int x, int y){
+
+	if(font->metrics_only) return;
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_DRAW_TEXT,font)){
+		fontTraceInt(x);
+		fontTraceInt(y);
+		fontTraceString(text);
+	}
+#endif
+
+	FontTextPen pen;
+	fontBeginTextPen(font,&pen,x,y);
+	
+	for(const unsigned char* t = text; *t;)
+		fontPutTextPen(font,&pen,*t < 0x80 ? *t++ : fontDecodeUTF8(&t,4));
+	
+	fontEndTextPen(font,&pen);
+
+}
+
+
+
+#endif //#else TEXT_ENGINE_USE_MODERN_OPENGL
+
+TEXTENGINEDEF Font* createFont(const char* font_name, int size){
+
+	Font* font = createFontAsync(font_name,size);
+	
+	if(font)
+		while(!updateFontLoading(font,TEXT_ENGINE_UPLOAD_BUFFER_SIZE));
+	
+	return font;
+	
+}
+
+TEXTENGINEDEF int updateFontLoading(Font* font, int bytes_budget){
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_UPDATE_FONT_LOADING,font))
+		fontTraceInt(bytes_budget);
+#endif
+
+	if(font->metrics_only || font->loaded_glyphs >= TEXT_ENGINE_MAX_GLYPHS_COUNT) return 1;
+	
+	int uploaded_bytes = 0;
+	
+	fontBeginUpload(font);
+	
+	do{
+		int i = font->loaded_glyphs++;
+		uploaded_bytes += fontLoadGlyph(font,i,&font->letters[i],&font->advances[i],uploaded_bytes);
+	}while(font->loaded_glyphs < TEXT_ENGINE_MAX_GLYPHS_COUNT && uploaded_bytes < bytes_budget);
+	
+	fontEndUpload(font);
+	
+	return font->loaded_glyphs >= TEXT_ENGINE_MAX_GLYPHS_COUNT;
+
+}
+
+TEXTENGINEDEF int addFontFallback(Font* font, const char* font_name){
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_ADD_FONT_FALLBACK,font))
+		fontTraceString((const unsigned char*)font_name);
+#endif
+
+	if(font->metrics_only){
+		puts("Text Engine: Fallbacks can not be added to metrics fonts");
+		return 0;
+	}
+	
+	int previous_faces = font->faces_count;
+	if(!fontOpenFace(font,font_name)) return 0;
+	
+	//Glyphs already loaded that are missing on the previous faces are loaded again from the fallback
+	int uploaded_bytes = 0;
+	
+	fontBeginUpload(font);
+	
+	for(int i = 0; i < font->loaded_glyphs; i++)
+		if(fontFindCharFace(font,i) == previous_faces)
+			uploaded_bytes += fontLoadGlyph(font,i,&font->letters[i],&font->advances[i],uploaded_bytes);
+	
+	fontEndUpload(font);
+	
+	//Characters of the glyph table are only marked, they are rendered from the fallback when next drawn
+	FT_Face face = font->ft_faces[previous_faces];
+	for(int i = 0; i < font->glyphs_capacity; i++){
+		FontGlyph* glyph = &font->glyphs[i];
+		if(!glyph->code || !glyph->missing || fontFindCharFace(font,glyph->code) != previous_faces) continue;
+		FT_Load_Char(face,glyph->code,FT_LOAD_DEFAULT);
+		glyph->advance = face->glyph->advance.x>>6;
+		glyph->missing = 0;
+		glyph->rendered = 0;
+	}
+	
+	return 1;
+
+}
+
+TEXTENGINEDEF int isFontReady(Font* font){
+	if(font->metrics_only) return 0; //Never drawable
+	return font->loaded_glyphs >= 128 || font->loaded_glyphs >= TEXT_ENGINE_MAX_GLYPHS_COUNT;
+}
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+TEXTENGINEDEF Font* createFontMetrics(const char* font_name, int size){
+
+	//The whole struct is allocated and cleared, so a metrics font passed to a drawing call reads empty render data
+	Font* font = (Font*)TEXT_ENGINE_MALLOC(sizeof(Font));
+	memset(font,0,sizeof(Font));
+	font->size = size;
+	font->tab_size = 4;
+	font->metrics_only = 1;
+	font->scale_x = 1.0f, font->scale_y = 1.0f;
+	
+	FT_Library ft;
+	if( FT_Init_FreeType(&ft) ){
+		puts("Text Engine: Failed to init FreeType2 Library");
+		TEXT_ENGINE_FREE(font);
+		return 0;
+	}
+	FT_Face face;
+	if( FT_New_Face(ft,font_name,0,&face) ){
+		printf("Text Engine: Failed to load font: %s\n",font_name);
+		FT_Done_FreeType(ft);
+		TEXT_ENGINE_FREE(font);
+		return 0;
+	}
+	FT_Set_Pixel_Sizes(face,0,size);
+	
+	//Advances do not need bitmaps, only the glyph used as tab unit is rendered, to match the width drawText uses
+	font->digit_advance = 0;
+	for(int i = 0; i < TEXT_ENGINE_MAX_GLYPHS_COUNT; i++){
+		FT_Load_Char(face,i,FT_LOAD_DEFAULT);
+		font->advances[i] = face->glyph->advance.x>>6;
+		if(i >= '0' && i <= '9' && font->digit_advance < font->advances[i])
+			font->digit_advance = font->advances[i];
+	}
+	
+	//Every other character of the face goes on the glyph table now, so measuring never writes to the font (and stays safe
+	//from many threads), characters not on it take the missing glyph advance
+	if(!FT_Load_Glyph(face,0,FT_LOAD_DEFAULT))
+		font->missing_glyph.advance = face->glyph->advance.x>>6;
+	
+	FT_UInt glyph_index;
+	FT_ULong c = FT_Get_First_Char(face,&glyph_index);
+	while(glyph_index){
+		if(c >= TEXT_ENGINE_MAX_GLYPHS_COUNT){
+			FT_Load_Glyph(face,glyph_index,FT_LOAD_DEFAULT);
+			fontInsertGlyph(font,c)->advance = face->glyph->advance.x>>6;
 		}
-		
+		c = FT_Get_Next_Char(face,c,&glyph_index);
 	}
 	
-	glPopMatrix();
+	font->tab_unit = 0;
+	if(TEXT_ENGINE_MAX_GLYPHS_COUNT > 31 && !FT_Load_Char(face,31,FT_LOAD_RENDER))
+		font->tab_unit = face->glyph->bitmap.width;
+	font->tab_width = font->tab_unit * font->tab_size;
 	
-	glColor4f(old_color[0], old_color[1], old_color[2], old_color[3]);
+	FT_Done_Face(face);
+	FT_Done_FreeType(ft);
 	
-	glMatrixMode(GL_PROJECTION);
-	glLoadMatrixf(gl_current_ortho);
-	glMatrixMode(matrix_mode);
+#ifdef TEXT_ENGINE_TRACE
+	font->trace_id = ++font_trace_ids;
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_CREATE_FONT_METRICS,font)){
+		fontTraceInt(size);
+		fontTraceString((const unsigned char*)font_name);
+	}
+#endif
 	
-	if(!is_gldepthtest_active)
-		glDisable(GL_DEPTH_TEST);
+	return font;
+
+}
+
+TEXTENGINEDEF void deleteFont(Font* font){
+
+#ifdef TEXT_ENGINE_TRACE
+	fontTraceBegin(TEXT_ENGINE_TRACE_DELETE_FONT,font);
+#endif
+
+	if(font->glyphs) TEXT_ENGINE_FREE(font->glyphs);
 	
-	glDepthFunc(gldepth_func);
+	if(font->metrics_only){
+		TEXT_ENGINE_FREE(font);
+		return;
+	}
 	
-	if(!is_glalphatest_active)
-		glDisable(GL_ALPHA_TEST);
-		
-	glAlphaFunc(glalpha_func, 0.0);
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	fontCloseFaces(font);
 	
-	if(temp_gl_blend_src != GL_SRC_ALPHA || temp_gl_blend_dst != GL_ONE_MINUS_SRC_ALPHA)
-		glBlendFunc(temp_gl_blend_src,temp_gl_blend_dst);
+	glDeleteTextures(font->pages_count,font->pages);
 	
-	if(!is_gltexture2d_active)
-		glDisable(GL_TEXTURE_2D);
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+	fontDeleteCachedTexts(font);
+	glDeleteBuffers(1,&font->pixel_buffer);
+	glDeleteBuffers(2,font->vertex_buffers);
+	glDeleteVertexArrays(1,&font->vertex_array);
+	glDeleteProgram(font->shader);
+#endif
+#endif //TEXT_ENGINE_METRICS_ONLY
 	
-	if(!is_glblend_active)
-		glDisable(GL_BLEND);
+	TEXT_ENGINE_FREE(font);
 
 }
 
-
-
-#endif //#else TEXT_ENGINE_USE_MODERN_OPENGL
+#ifndef TEXT_ENGINE_METRICS_ONLY
 
 TEXTENGINEDEF void drawCenteredText(Font* font, const unsigned char* text, int x, int y){
 	drawText(font, text, x - getSizeText(font, text) * 0.5, y);
@@ -661,15 +2606,114 @@ TEXTENGINEDEF void drawRightedText(Font* font, const unsigned char* text, int x,
 	drawText(font, text, x - getSizeText(font, text), y);
 }
 
+TEXTENGINEDEF void fontPenSink(Font* font, void* sink, unsigned int c, int digit){
+
+	FontTextPen* pen = (FontTextPen*)sink;
+	
+	if(!digit){
+		fontPutTextPen(font,pen,c);
+		return;
+	}
+	
+	//Digit centered on a cell of the widest digit advance
+	int offset = (font->digit_advance - font->advances[c]) / 2;
+	pen->x += offset;
+	fontPutTextPen(font,pen,c);
+	pen->x += font->digit_advance - font->advances[c] - offset;
+
+}
+
+TEXTENGINEDEF void fontDrawTextFormat(Font* font, int x, int y, int text_align, const char* format, va_list args){
+
+	if(font->metrics_only) return;
+	
+	if(text_align){
+#ifdef TEXT_ENGINE_TRACE
+		if(fontTraceBegin(TEXT_ENGINE_TRACE_GET_SIZE_TEXT,font)){ //Measured as drawCenteredText and drawRightedText do with getSizeText
+			va_list trace_args;
+			va_copy(trace_args,args);
+			fontTraceFormat(font,format,trace_args);
+			va_end(trace_args);
+		}
+#endif
+		va_list measure_args;
+		va_copy(measure_args,args);
+		int measure[2] = {0,0};
+		fontFormatText(font,fontMeasureSink,measure,format,measure_args);
+		va_end(measure_args);
+		
+		int text_width = (measure[0] > measure[1] ? measure[0] : measure[1]) * font->scale_x;
+		if(text_align == 1){ //ALIGN_CENTERED
+			x -= text_width * 0.5;
+		}else if(text_align == 2){ //ALIGN_RIGHTED
+			x -= text_width;
+		}
+	}
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_DRAW_TEXT,font)){
+		va_list trace_args;
+		va_copy(trace_args,args);
+		fontTraceInt(x);
+		fontTraceInt(y);
+		fontTraceFormat(font,format,trace_args);
+		va_end(trace_args);
+	}
+#endif
+
+	FontTextPen pen;
+	fontBeginTextPen(font,&pen,x,y);
+	fontFormatText(font,fontPenSink,&pen,format,args);
+	fontEndTextPen(font,&pen);
+
+}
+
+TEXTENGINEDEF void drawTextFormat(Font* font, int x, int y, const char* format, ...){
+	va_list args;
+	va_start(args,format);
+	fontDrawTextFormat(font,x,y,0,format,args);
+	va_end(args);
+}
+
+TEXTENGINEDEF void drawCenteredTextFormat(Font* font, int x, int y, const char* format, ...){
+	va_list args;
+	va_start(args,format);
+	fontDrawTextFormat(font,x,y,1,format,args);
+	va_end(args);
+}
+
+TEXTENGINEDEF void drawRightedTextFormat(Font* font, int x, int y, const char* format, ...){
+	va_list args;
+	va_start(args,format);
+	fontDrawTextFormat(font,x,y,2,format,args);
+	va_end(args);
+}
+
 TEXTENGINEDEF void setFontFreeTransform(Font* font, int free_transform){
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_FREE_TRANSFORM,font))
+		fontTraceInt(free_transform);
+#endif
 	font->free_transform = free_transform;
 }
 
 TEXTENGINEDEF void setFontDepth(Font* font, float depth){
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_DEPTH,font))
+		fontTraceFloat(depth);
+#endif
 	font->depth = depth;
 }
 
 TEXTENGINEDEF void setFontColor(Font* font, float r, float g, float b, float a){
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_COLOR,font)){
+		fontTraceFloat(r);
+		fontTraceFloat(g);
+		fontTraceFloat(b);
+		fontTraceFloat(a);
+	}
+#endif
 	font->color_r = r;
 	font->color_g = g;
 	font->color_b = b;
@@ -677,31 +2721,57 @@ TEXTENGINEDEF void setFontColor(Font* font, float r, float g, float b, float a){
 }
 
 TEXTENGINEDEF void setFontCanvasSize(Font* font, int width, int height, int depth){
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_CANVAS_SIZE,font)){
+		fontTraceInt(width);
+		fontTraceInt(height);
+		fontTraceInt(depth);
+	}
+#endif
 	font->canvas_width = width;
 	font->canvas_height = height;
 	font->canvas_depth = depth;
 	fontCreateOrthographicMatrix(0,font->canvas_width,font->canvas_height,0,-font->canvas_depth,font->canvas_depth,font->projection_matrix);
 }
 
+#endif //TEXT_ENGINE_METRICS_ONLY
+
 TEXTENGINEDEF void setTabSize(Font* font, const int tab_size){
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_TAB_SIZE,font))
+		fontTraceInt(tab_size);
+#endif
 	font->tab_size = tab_size;
+	font->tab_width = font->tab_unit * tab_size;
 }
 
 TEXTENGINEDEF void setFontScale(Font* font, float scale){
 	font->scale_x = scale;
 	font->scale_y = scale;
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_SCALE,font)){
+		fontTraceFloat(font->scale_x);
+		fontTraceFloat(font->scale_y);
+	}
+#endif
 }
 
 TEXTENGINEDEF void setFontScaleInPixels(Font* font, float scale_in_pixels){
 	font->scale_x = scale_in_pixels / (float)font->size;
 	font->scale_y = scale_in_pixels / (float)font->size;
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_SET_FONT_SCALE,font)){
+		fontTraceFloat(font->scale_x);
+		fontTraceFloat(font->scale_y);
+	}
+#endif
 }
 
 TEXTENGINEDEF int getTextLinesCount(const unsigned char* text){
 
 	int lines_count = 1;
 	
-	for(unsigned int i = 0; i < strlen((char*)text); i++){
+	for(unsigned int i = 0; text[i]; i++){
 		if(text[i] == '\n'){
 			lines_count += 1;
 		}
@@ -713,18 +2783,25 @@ TEXTENGINEDEF int getTextLinesCount(const unsigned char* text){
 
 TEXTENGINEDEF int getSizeText(Font* font, const unsigned char* text){
 
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_GET_SIZE_TEXT,font))
+		fontTraceString(text);
+#endif
+
 	int max_width = 0;
 	int x = 0;
 	
-	for(unsigned int i = 0; i < strlen((char*)text); i++){
+	for(const unsigned char* t = text; *t;){
 	
-		if(text[i] == '\n'){
+		unsigned int c = *t < 0x80 ? *t++ : fontDecodeUTF8(&t,4);
+		
+		if(c == '\n'){
 			if(max_width < x) max_width = x;
 			x = 0;
-		}else if(text[i] == '	'){
-			x += font->letters[31].width * font->tab_size;
+		}else if(c == '	'){
+			x += font->tab_width;
 		}else{
-			x += font->letters[(int)text[i]].advance>>6;
+			x += fontGetAdvance(font,c);
 		}
 		
 	}
@@ -736,9 +2813,14 @@ TEXTENGINEDEF int getSizeText(Font* font, const unsigned char* text){
 
 TEXTENGINEDEF int getHeightText(Font* font, const unsigned char* text){
 
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_GET_HEIGHT_TEXT,font))
+		fontTraceString(text);
+#endif
+
 	int max_height = font->size;
 	
-	for(unsigned int i = 0; i < strlen((char*)text); i++){
+	for(unsigned int i = 0; text[i]; i++){
 	
 		if(text[i] == '\n'){
 			max_height += font->size;
@@ -784,6 +2866,625 @@ TEXTENGINEDEF int getTextAABB(Font* font, const unsigned char* text, int text_x,
 }
 
 
+//============================== Formatted Text ==============================
+
+TEXTENGINEDEF void fontFormatText(Font* font, FontFormatSink put, void* sink, const char* format, va_list args){
+
+	for(const unsigned char* f = (const unsigned char*)format; *f; f++){
+	
+		if(*f != '%'){
+			if(*f < 0x80){
+				put(font,sink,*f,0);
+			}else{
+				unsigned int c = fontDecodeUTF8(&f,4);
+				put(font,sink,c,0);
+				f--; //Back on the last byte of the character, the loop moves past it
+			}
+			continue;
+		}
+		const unsigned char* conversion = f; //Written back as it is when not supported
+		f++;
+		
+		int left_justify = 0, zero_pad = 0, alternate = 0, width = 0, precision = -1;
+		int size = 0; //0 int, 1 long, 2 long long, 3 size_t, 4 ptrdiff_t, 5 long double, 6 char, 7 short
+		char sign = 0;
+		
+		for(;; f++){
+			if(*f == '-') left_justify = 1;
+			else if(*f == '0') zero_pad = 1;
+			else if(*f == '+') sign = '+';
+			else if(*f == ' '){ if(!sign) sign = ' '; }
+			else if(*f == '#') alternate = 1;
+			else break;
+		}
+		
+		if(*f == '*'){
+			width = va_arg(args,int);
+			if(width < 0){ //A negative width is a - flag
+				left_justify = 1;
+				width = -width;
+			}
+			f++;
+		}else{
+			while(*f >= '0' && *f <= '9') width = width * 10 + (*f++ - '0');
+		}
+		
+		if(*f == '.'){
+			f++;
+			precision = 0;
+			if(*f == '*'){
+				precision = va_arg(args,int);
+				if(precision < 0) precision = -1; //A negative precision is as if it was not given
+				f++;
+			}else{
+				while(*f >= '0' && *f <= '9') precision = precision * 10 + (*f++ - '0');
+			}
+		}
+		
+		if(*f == 'l'){
+			size = 1;
+			if(*++f == 'l'){
+				size = 2;
+				f++;
+			}
+		}else if(*f == 'z'){
+			size = 3;
+			f++;
+		}else if(*f == 't'){
+			size = 4;
+			f++;
+		}else if(*f == 'L'){
+			size = 5;
+			f++;
+		}else if(*f == 'h'){ //Passed as int, narrowed as printf does
+			size = 7;
+			if(*++f == 'h'){
+				size = 6;
+				f++;
+			}
+		}
+		
+		switch(*f){
+		
+			case 'd': case 'i':{
+				long long value;
+				if(size == 1) value = va_arg(args,long);
+				else if(size == 2) value = va_arg(args,long long);
+				else if(size == 3 || size == 4) value = va_arg(args,ptrdiff_t);
+				else if(size == 6) value = (signed char)va_arg(args,int);
+				else if(size == 7) value = (short)va_arg(args,int);
+				else value = va_arg(args,int);
+				unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+				fontFormatInteger(font,put,sink,magnitude,10,0,0,value < 0 ? '-' : sign,width,precision,zero_pad,left_justify);
+			}break;
+			
+			case 'u': case 'o': case 'x': case 'X':{
+				unsigned long long value;
+				if(size == 1) value = va_arg(args,unsigned long);
+				else if(size == 2) value = va_arg(args,unsigned long long);
+				else if(size == 3 || size == 4) value = va_arg(args,size_t);
+				else if(size == 6) value = (unsigned char)va_arg(args,unsigned int);
+				else if(size == 7) value = (unsigned short)va_arg(args,unsigned int);
+				else value = va_arg(args,unsigned int);
+				fontFormatInteger(font,put,sink,value,*f == 'u' ? 10 : *f == 'o' ? 8 : 16,*f == 'X',alternate,0,width,precision,zero_pad,left_justify);
+			}break;
+			
+			case 'f': case 'F':{
+				double value = size == 5 ? (double)va_arg(args,long double) : va_arg(args,double);
+				fontFormatFloat(font,put,sink,value,precision < 0 ? 6 : precision,alternate,sign,width,zero_pad,left_justify);
+			}break;
+			
+			case 'c':{
+				if(!left_justify) for(int i = 1; i < width; i++) put(font,sink,' ',0);
+				put(font,sink,(unsigned char)va_arg(args,int),0);
+				if(left_justify) for(int i = 1; i < width; i++) put(font,sink,' ',0);
+			}break;
+			
+			case 's':{
+				const unsigned char* text = va_arg(args,const unsigned char*);
+				if(size == 1){ //Wide string, not supported
+					for(; conversion <= f; conversion++) put(font,sink,*conversion,0);
+					break;
+				}
+				if(!text) text = (const unsigned char*)"(null)";
+				int length = 0;
+				if(width) while(text[length] && (precision < 0 || length < precision)) length++; //Only padded strings are measured
+				if(!left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+				for(const unsigned char* t = text; *t && (precision < 0 || t - text < precision);){
+					int available = precision < 0 ? 4 : precision - (int)(t - text); //Precision counts bytes, a cut character is written byte by byte
+					put(font,sink,*t < 0x80 ? *t++ : fontDecodeUTF8(&t,available),0);
+				}
+				if(left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+			}break;
+			
+			case '%': put(font,sink,'%',0); break;
+			
+			//printf conversions not supported, their argument is taken so the next conversions read the right ones
+			case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':{
+				if(size == 5) va_arg(args,long double);
+				else va_arg(args,double);
+				for(; conversion <= f; conversion++) put(font,sink,*conversion,0);
+			}break;
+			
+			case 'p': case 'n':{
+				va_arg(args,void*);
+				if(*f == 'p') for(; conversion <= f; conversion++) put(font,sink,*conversion,0);
+			}break;
+			
+			default: return; //End of the format, or not a printf conversion, so the type of its argument is unknown and nothing after it can be read
+			
+		}
+		
+	}
+
+}
+
+TEXTENGINEDEF void fontFormatInteger(Font* font, FontFormatSink put, void* sink, unsigned long long value, int base, int upper_case, int alternate, char sign, int width, int precision, int zero_pad, int left_justify){
+
+	//Digits are written from the most significant one, so no digit buffer is needed
+	unsigned long long divisor = 1;
+	int digits = 1;
+	while(value / divisor >= (unsigned long long)base){
+		divisor *= base;
+		digits++;
+	}
+	
+	//The precision is the minimum number of digits, and a 0 with a precision of 0 has none
+	if(precision == 0 && value == 0){
+		divisor = 0;
+		digits = 0;
+	}
+	int leading_zeros = precision > digits ? precision - digits : 0;
+	if(precision >= 0) zero_pad = 0;
+	
+	//The # flag starts octal numbers with a 0 and hexadecimal ones (but 0) with 0x
+	if(alternate && base == 8 && !leading_zeros && (value || !digits)) leading_zeros = 1;
+	int prefix = alternate && base == 16 && value;
+	
+	int length = leading_zeros + digits + (sign != 0) + prefix * 2;
+	
+	if(!left_justify && !zero_pad) for(int i = length; i < width; i++) put(font,sink,' ',0);
+	if(sign) put(font,sink,sign,0);
+	if(prefix){
+		put(font,sink,'0',0);
+		put(font,sink,upper_case ? 'X' : 'x',0);
+	}
+	if(!left_justify && zero_pad) for(int i = length; i < width; i++) put(font,sink,'0',1);
+	for(int i = 0; i < leading_zeros; i++) put(font,sink,'0',1);
+	
+	for(; divisor; divisor /= base){
+		int digit = value / divisor;
+		value -= digit * divisor;
+		if(digit < 10) put(font,sink,'0' + digit,1);
+		else put(font,sink,(upper_case ? 'A' : 'a') + digit - 10,0);
+	}
+	
+	if(left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+
+}
+
+TEXTENGINEDEF void fontFormatFloat(Font* font, FontFormatSink put, void* sink, double value, int precision, int alternate, char sign, int width, int zero_pad, int left_justify){
+
+	if(signbit(value)){ //Also keeps the sign of -0.0
+		sign = '-';
+		value = -value;
+	}
+	
+	if(value != value || value - value != value - value){ //NaN or infinity, padded with spaces even with the 0 flag
+		const char* name = value != value ? "nan" : "inf";
+		int length = 3 + (sign != 0);
+		if(!left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+		if(sign) put(font,sink,sign,0);
+		for(int i = 0; name[i]; i++) put(font,sink,name[i],0);
+		if(left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+		return;
+	}
+	
+	//The value is mantissa * 2^exponent with an integer mantissa, its decimal digits are found exactly from it with 32 bit limbs
+	//so the rounding is the one of printf. A double has at most 309 integer digits and 1126 fraction digits before only zeros
+	int exponent;
+	unsigned long long mantissa = (unsigned long long)ldexp(frexp(value,&exponent),53);
+	exponent -= 53;
+	
+	unsigned int limbs[37];
+	char integer_digits[320];
+	char fraction_digits[1130];
+	int integer_start = sizeof(integer_digits);
+	int fraction_bits = exponent < 0 ? -exponent : 0;
+	
+	if(exponent >= 0){
+	
+		int count = exponent / 32;
+		for(int i = 0; i < count; i++) limbs[i] = 0;
+		unsigned long long low = mantissa << (exponent % 32);
+		unsigned long long high = exponent % 32 ? mantissa >> (64 - exponent % 32) : 0;
+		limbs[count++] = (unsigned int)low;
+		limbs[count++] = (unsigned int)(low >> 32);
+		limbs[count++] = (unsigned int)high;
+		while(count && !limbs[count - 1]) count--;
+		
+		//Divided by 10^9 until 0, each remainder being the next 9 digits
+		while(count){
+			unsigned long long remainder = 0;
+			for(int i = count - 1; i >= 0; i--){
+				unsigned long long current = remainder << 32 | limbs[i];
+				limbs[i] = (unsigned int)(current / 1000000000);
+				remainder = current % 1000000000;
+			}
+			while(count && !limbs[count - 1]) count--;
+			for(int i = 0; i < 9; i++){
+				integer_digits[--integer_start] = '0' + remainder % 10;
+				remainder /= 10;
+			}
+		}
+		
+	}else{
+	
+		unsigned long long integer = fraction_bits < 64 ? mantissa >> fraction_bits : 0;
+		do{
+			integer_digits[--integer_start] = '0' + integer % 10;
+			integer /= 10;
+		}while(integer);
+		
+		if(fraction_bits < 64) mantissa &= (1ull << fraction_bits) - 1;
+		
+	}
+	
+	while(integer_start < (int)sizeof(integer_digits) - 1 && integer_digits[integer_start] == '0') integer_start++;
+	if(integer_start == sizeof(integer_digits)) integer_digits[--integer_start] = '0';
+	
+	//Fraction digits, the fraction being limbs / 2^fraction_bits, it is multiplied by 10 and its integer part is the next digit
+	int fraction_count = precision < fraction_bits ? precision : fraction_bits;
+	
+	if(fraction_bits){
+	
+		int top = fraction_bits / 32;
+		int shift = fraction_bits % 32;
+		int count = top + 2;
+		for(int i = 0; i < count; i++) limbs[i] = 0;
+		for(int i = 0; i < 2; i++) limbs[i] = (unsigned int)(mantissa >> (32 * i));
+		
+		for(int d = 0; d < fraction_count; d++){
+			unsigned long long carry = 0;
+			for(int i = 0; i < count; i++){
+				unsigned long long current = (unsigned long long)limbs[i] * 10 + carry;
+				limbs[i] = (unsigned int)current;
+				carry = current >> 32;
+			}
+			fraction_digits[d] = '0' + (char)(((unsigned long long)limbs[top + 1] << 32 | limbs[top]) >> shift);
+			limbs[top] &= (1u << shift) - 1;
+			limbs[top + 1] = 0;
+		}
+		
+		//What is left is compared to a half, exact halves go to the even digit
+		if(fraction_count < fraction_bits){
+			int half_limb = (fraction_bits - 1) / 32;
+			unsigned int half_bit = 1u << (fraction_bits - 1) % 32;
+			int above_half = 0;
+			if(limbs[half_limb] & half_bit){
+				above_half = (limbs[half_limb] & (half_bit - 1)) != 0;
+				for(int i = 0; i < half_limb && !above_half; i++) above_half = limbs[i] != 0;
+				char last_digit = fraction_count ? fraction_digits[fraction_count - 1] : integer_digits[sizeof(integer_digits) - 1];
+				if(above_half || (last_digit - '0') % 2){
+					int d = fraction_count - 1;
+					for(; d >= 0 && fraction_digits[d] == '9'; d--) fraction_digits[d] = '0';
+					if(d >= 0){
+						fraction_digits[d]++;
+					}else{
+						int i = sizeof(integer_digits) - 1;
+						for(; i >= integer_start && integer_digits[i] == '9'; i--) integer_digits[i] = '0';
+						if(i >= integer_start) integer_digits[i]++;
+						else integer_digits[--integer_start] = '1';
+					}
+				}
+			}
+		}
+		
+	}
+	
+	int digits = sizeof(integer_digits) - integer_start;
+	int length = digits + (sign != 0) + precision + (precision || alternate); //The # flag keeps the point without fraction digits
+	
+	if(!left_justify && !zero_pad) for(int i = length; i < width; i++) put(font,sink,' ',0);
+	if(sign) put(font,sink,sign,0);
+	if(!left_justify && zero_pad) for(int i = length; i < width; i++) put(font,sink,'0',1);
+	
+	for(int i = integer_start; i < (int)sizeof(integer_digits); i++) put(font,sink,integer_digits[i],1);
+	
+	if(precision || alternate) put(font,sink,'.',0);
+	for(int i = 0; i < precision; i++) put(font,sink,i < fraction_count ? fraction_digits[i] : '0',1);
+	
+	if(left_justify) for(int i = length; i < width; i++) put(font,sink,' ',0);
+
+}
+
+TEXTENGINEDEF void fontMeasureSink(Font* font, void* sink, unsigned int c, int digit){
+
+	int* measure = (int*)sink; //x of the pen and width of the widest line ended
+	
+	if(c == '\n'){
+		if(measure[1] < measure[0]) measure[1] = measure[0];
+		measure[0] = 0;
+	}else if(c == '	'){
+		measure[0] += font->tab_width;
+	}else{
+		measure[0] += digit ? font->digit_advance : fontGetAdvance(font,c);
+	}
+
+}
+
+TEXTENGINEDEF int getSizeTextFormat(Font* font, const char* format, ...){
+
+	va_list args;
+	va_start(args,format);
+
+#ifdef TEXT_ENGINE_TRACE
+	if(fontTraceBegin(TEXT_ENGINE_TRACE_GET_SIZE_TEXT,font)){
+		va_list trace_args;
+		va_copy(trace_args,args);
+		fontTraceFormat(font,format,trace_args);
+		va_end(trace_args);
+	}
+#endif
+
+	int measure[2] = {0,0};
+	fontFormatText(font,fontMeasureSink,measure,format,args);
+	va_end(args);
+	
+	if(measure[1] < measure[0]) measure[1] = measure[0];
+	
+	return measure[1] * font->scale_x;
+
+}
+
+//============================== Text Index ==============================
+
+TEXTENGINEDEF void fontReserveTextIndexLine(TextIndexLine* line, int length){
+
+	if(length < line->capacity) return;
+	
+	while(line->capacity <= length) line->capacity = line->capacity ? line->capacity * 2 : 16;
+	line->prefix = (int*)TEXT_ENGINE_REALLOC(line->prefix,sizeof(int)*line->capacity);
+
+}
+
+TEXTENGINEDEF int fontFindTextIndexLine(TextIndex* index, int position){
+
+	//Last line starting at or before position
+	int low = 0, high = index->lines_count - 1;
+	
+	while(low < high){
+		int middle = (low + high + 1) / 2;
+		if(index->lines[middle].start <= position) low = middle;
+		else high = middle - 1;
+	}
+	
+	return low;
+
+}
+
+TEXTENGINEDEF TextIndex* createTextIndex(Font* font, const unsigned char* text){
+
+	TextIndex* index = (TextIndex*)TEXT_ENGINE_MALLOC(sizeof(TextIndex));
+	index->font = font;
+	index->length = 0;
+	index->lines_count = 1;
+	index->lines_capacity = 16;
+	index->lines = (TextIndexLine*)TEXT_ENGINE_MALLOC(sizeof(TextIndexLine)*index->lines_capacity);
+	
+	TextIndexLine* line = &index->lines[0];
+	line->start = line->length = line->capacity = 0;
+	line->prefix = 0;
+	fontReserveTextIndexLine(line,0);
+	line->prefix[0] = 0;
+	
+	insertTextIndex(index,0,text,strlen((const char*)text));
+	
+	return index;
+
+}
+
+TEXTENGINEDEF int getTextIndexAtPoint(TextIndex* index, int x, int y){
+
+	Font* font = index->font;
+	
+	int line_number = y / (font->size * font->scale_y);
+	if(y < 0) line_number = 0;
+	if(line_number >= index->lines_count) line_number = index->lines_count - 1;
+	
+	TextIndexLine* line = &index->lines[line_number];
+	int line_x = x / font->scale_x;
+	
+	//Last caret at or before line_x, then the closest of it and the next one
+	int low = 0, high = line->length;
+	
+	while(low < high){
+		int middle = (low + high + 1) / 2;
+		if(line->prefix[middle] <= line_x) low = middle;
+		else high = middle - 1;
+	}
+	
+	if(low < line->length && line_x - line->prefix[low] > line->prefix[low+1] - line_x)
+		low++;
+	
+	while(low > 0 && line->prefix[low-1] == line->prefix[low]) low--; //First byte of the character
+	
+	return line->start + low;
+
+}
+
+TEXTENGINEDEF void getTextIndexPoint(TextIndex* index, int position, int* x, int* y){
+
+	if(position < 0) position = 0;
+	if(position > index->length) position = index->length;
+	
+	int line_number = fontFindTextIndexLine(index,position);
+	TextIndexLine* line = &index->lines[line_number];
+	
+	*x = line->prefix[position - line->start] * index->font->scale_x;
+	*y = line_number * index->font->size * index->font->scale_y;
+
+}
+
+TEXTENGINEDEF int getTextSelectionRects(TextIndex* index, int start, int end, int* rects, int max_rects){
+
+	Font* font = index->font;
+	
+	if(start > end){ int temp = start; start = end; end = temp; }
+	if(start < 0) start = 0;
+	if(end > index->length) end = index->length;
+	
+	int first_line = fontFindTextIndexLine(index,start);
+	int last_line = fontFindTextIndexLine(index,end);
+	int rects_count = 0;
+	
+	for(int i = first_line; i <= last_line && rects_count < max_rects; i++){
+	
+		TextIndexLine* line = &index->lines[i];
+		int x0 = i == first_line ? line->prefix[start - line->start] : 0;
+		int x1 = i == last_line ? line->prefix[end - line->start] : line->prefix[line->length];
+		
+		int* rect = rects + rects_count * 4;
+		rect[0] = x0 * font->scale_x;
+		rect[1] = i * font->size * font->scale_y;
+		rect[2] = (x1 - x0) * font->scale_x;
+		rect[3] = font->size * font->scale_y;
+		rects_count++;
+		
+	}
+	
+	return rects_count;
+
+}
+
+TEXTENGINEDEF void insertTextIndex(TextIndex* index, int position, const unsigned char* text, int length){
+
+	Font* font = index->font;
+	
+	if(position < 0) position = 0;
+	if(position > index->length) position = index->length;
+	
+	int new_lines = 0;
+	for(int i = 0; i < length; i++)
+		if(text[i] == '\n') new_lines++;
+	
+	int line_number = fontFindTextIndexLine(index,position);
+	TextIndexLine* line = &index->lines[line_number];
+	int column = position - line->start;
+	
+	if(new_lines){
+	
+		if(index->lines_count + new_lines > index->lines_capacity){
+			while(index->lines_count + new_lines > index->lines_capacity) index->lines_capacity *= 2;
+			index->lines = (TextIndexLine*)TEXT_ENGINE_REALLOC(index->lines,sizeof(TextIndexLine)*index->lines_capacity);
+			line = &index->lines[line_number];
+		}
+		
+		memmove(line + 1 + new_lines,line + 1,sizeof(TextIndexLine)*(index->lines_count - line_number - 1));
+		index->lines_count += new_lines;
+		
+		for(int i = 1; i <= new_lines; i++){
+			line[i].length = line[i].capacity = 0;
+			line[i].prefix = 0;
+			fontReserveTextIndexLine(&line[i],0);
+			line[i].prefix[0] = 0;
+		}
+		
+		//The characters after the position go to the end of the last new line
+		TextIndexLine* last = &line[new_lines];
+		int tail_length = line->length - column;
+		fontReserveTextIndexLine(last,tail_length);
+		for(int i = 0; i <= tail_length; i++)
+			last->prefix[i] = line->prefix[column + i] - line->prefix[column];
+		last->length = tail_length;
+		line->length = column;
+		
+	}
+	
+	//Insert each segment at the column of the current line, shifting what is after it
+	for(int i = 0; i <= length; i++){
+	
+		int segment_start = i;
+		while(i < length && text[i] != '\n') i++;
+		int segment_length = i - segment_start;
+		
+		fontReserveTextIndexLine(line,line->length + segment_length);
+		memmove(line->prefix + column + segment_length,line->prefix + column,sizeof(int)*(line->length - column + 1));
+		
+		//Positions are bytes, the bytes of a UTF-8 character share the x of its caret
+		int x = line->prefix[column + segment_length];
+		for(int k = 0; k < segment_length;){
+			const unsigned char* t = text + segment_start + k;
+			unsigned int c = *t < 0x80 ? *t++ : fontDecodeUTF8(&t,segment_length - k);
+			for(int end = t - text - segment_start; k < end; k++)
+				line->prefix[column + k] = x;
+			x += c == '	' ? font->tab_width : fontGetAdvance(font,c);
+		}
+		
+		int width = x - line->prefix[column + segment_length];
+		for(int k = column + segment_length; k <= line->length + segment_length; k++)
+			line->prefix[k] += width;
+		line->length += segment_length;
+		
+		line++;
+		column = 0;
+		
+	}
+	
+	index->length += length;
+	
+	for(int i = line_number + 1; i < index->lines_count; i++)
+		index->lines[i].start = index->lines[i-1].start + index->lines[i-1].length + 1;
+
+}
+
+TEXTENGINEDEF void eraseTextIndex(TextIndex* index, int position, int length){
+
+	if(position < 0){ length += position; position = 0; }
+	if(position + length > index->length) length = index->length - position;
+	if(length <= 0) return;
+	
+	int first_line = fontFindTextIndexLine(index,position);
+	int last_line = fontFindTextIndexLine(index,position + length);
+	TextIndexLine* first = &index->lines[first_line];
+	TextIndexLine* last = &index->lines[last_line];
+	int first_column = position - first->start;
+	int last_column = position + length - last->start;
+	
+	//What is left of the last line is joined to the start of the first one
+	int tail_length = last->length - last_column;
+	int x = first->prefix[first_column], removed_x = last->prefix[last_column];
+	
+	fontReserveTextIndexLine(first,first_column + tail_length);
+	memmove(first->prefix + first_column,last->prefix + last_column,sizeof(int)*(tail_length + 1));
+	for(int k = first_column; k <= first_column + tail_length; k++)
+		first->prefix[k] += x - removed_x;
+	first->length = first_column + tail_length;
+	
+	if(last_line > first_line){
+		for(int i = first_line + 1; i <= last_line; i++)
+			TEXT_ENGINE_FREE(index->lines[i].prefix);
+		memmove(first + 1,last + 1,sizeof(TextIndexLine)*(index->lines_count - last_line - 1));
+		index->lines_count -= last_line - first_line;
+	}
+	
+	index->length -= length;
+	
+	for(int i = first_line + 1; i < index->lines_count; i++)
+		index->lines[i].start = index->lines[i-1].start + index->lines[i-1].length + 1;
+
+}
+
+TEXTENGINEDEF void deleteTextIndex(TextIndex* index){
+
+	for(int i = 0; i < index->lines_count; i++)
+		TEXT_ENGINE_FREE(index->lines[i].prefix);
+	
+	TEXT_ENGINE_FREE(index->lines);
+	TEXT_ENGINE_FREE(index);
+
+}
+
 //============================== Internal Math Functions ==============================
 
 TEXTENGINEDEF void fontMultiplyMatrix4x4(float* m1, float* m2, float* dest){
@@ -0,0 +1,200 @@
+/*
+	Text Engine Alloc Test, checks that drawing does no heap allocation once warmed up (see Memory in text_engine.h).
+
+	It counts the calls to TEXT_ENGINE_MALLOC and TEXT_ENGINE_REALLOC, draws a few frames to warm up the batches and the frame
+	arena, and then fails if any of the next frames allocates. It runs headless, on an OpenGL context created with EGL.
+
+	Compiled on linux with: g++ -O2 tools/text_engine_alloc_test.cpp -o text_engine_alloc_test -lEGL -lGL `pkg-config --cflags --libs freetype2`
+	Add -DTEXT_ENGINE_USE_MODERN_OPENGL to check the modern OpenGL path (label batches and cached texts are only checked there).
+	Add -DTEXT_ENGINE_METRICS_ONLY (without -lEGL -lGL) to check only the metrics calls, with a createFontMetrics font.
+
+	Usage: text_engine_alloc_test font.ttf [-frames 100]
+
+	Returns 0 when no checked frame allocates, 1 otherwise.
+
+*/
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	#define GL_GLEXT_PROTOTYPES
+	#include<GL/gl.h>
+	#include<GL/glext.h>
+	#include<EGL/egl.h>
+	#include<EGL/eglext.h>
+#endif
+
+static long long alloc_test_allocations;
+
+static void* allocTestMalloc(size_t size){
+	alloc_test_allocations++;
+	return malloc(size);
+}
+
+static void* allocTestRealloc(void* data, size_t size){
+	alloc_test_allocations++;
+	return realloc(data,size);
+}
+
+#define TEXT_ENGINE_MALLOC(size) allocTestMalloc(size)
+#define TEXT_ENGINE_REALLOC(data,size) allocTestRealloc(data,size)
+#define TEXT_ENGINE_FREE(data) free(data)
+
+#define TEXT_ENGINE_IMPLEMENTATION
+#include"../text_engine.h"
+
+#define ALLOC_TEST_WARM_UP_FRAMES 3
+#define ALLOC_TEST_LABELS_COUNT 64
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
+static int allocTestCreateContext(int width, int height){
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	if(eglGetPlatformDisplayEXT)
+		display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,0);
+#endif
+	if(display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if(!eglInitialize(display,0,0)){
+		puts("Text Engine Alloc Test: Failed to init EGL");
+		return 0;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE,EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,EGL_OPENGL_BIT,
+		EGL_RED_SIZE,8,EGL_GREEN_SIZE,8,EGL_BLUE_SIZE,8,EGL_ALPHA_SIZE,8,
+		EGL_DEPTH_SIZE,24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs_count;
+	if(!eglChooseConfig(display,config_attributes,&config,1,&configs_count) || !configs_count){
+		puts("Text Engine Alloc Test: No EGL config for OpenGL");
+		return 0;
+	}
+
+	EGLint surface_attributes[] = {EGL_WIDTH,width,EGL_HEIGHT,height,EGL_NONE};
+	EGLSurface surface = eglCreatePbufferSurface(display,config,surface_attributes);
+
+	EGLContext context = eglCreateContext(display,config,EGL_NO_CONTEXT,0);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display,surface,surface,context)){
+		puts("Text Engine Alloc Test: Failed to create OpenGL context");
+		return 0;
+	}
+
+	glViewport(0,0,width,height);
+
+	return 1;
+
+}
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+int main(int argc, char** argv){
+
+	const char* font_name = 0;
+	int frames = 100;
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i],"-frames") && i + 1 < argc) frames = atoi(argv[++i]);
+		else font_name = argv[i];
+	}
+
+	if(!font_name){
+		puts("Usage: text_engine_alloc_test font.ttf [-frames 100]");
+		return 1;
+	}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	if(!allocTestCreateContext(800,600)) return 1;
+	Font* font = createFont(font_name,20);
+#else
+	Font* font = createFontMetrics(font_name,20);
+#endif
+	if(!font){
+		printf("Text Engine Alloc Test: Failed to load font: %s\n",font_name);
+		return 1;
+	}
+
+#if defined(TEXT_ENGINE_USE_MODERN_OPENGL) && !defined(TEXT_ENGINE_METRICS_ONLY)
+	FontLabelBatch* batch = createFontLabelBatch(font);
+	float transform[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+#endif
+
+	const unsigned char* text = (const unsigned char*)"Text Engine\n\tno allocation once warmed up";
+	const unsigned char* static_text = (const unsigned char*)"Static text\ndrawn from its cached texture";
+	int failed_frames = 0;
+
+	//Every frame draws the same kind of text, with numbers changing each frame, so warmed up memory is enough for all of them
+	for(int frame = 0; frame < ALLOC_TEST_WARM_UP_FRAMES + frames; frame++){
+
+		long long allocations = alloc_test_allocations;
+		int size = 0;
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		drawText(font,text,10,10);
+		drawCenteredText(font,text,400,60);
+		drawRightedText(font,text,790,110);
+		drawTextFormat(font,10,160,"frame %6d\tfps %6.2f",frame,60.0 - frame % 100 * 0.01);
+		drawCenteredTextFormat(font,400,210,"score %08d",frame * 37);
+		drawRightedTextFormat(font,790,260,"%-8s %+.3f",frame % 2 ? "odd" : "even",frame * 0.125);
+#endif
+
+		size += getSizeText(font,text);
+		size += getHeightText(font,text);
+		size += getSizeTextFormat(font,"frame %6d",frame);
+
+#if defined(TEXT_ENGINE_USE_MODERN_OPENGL) && !defined(TEXT_ENGINE_METRICS_ONLY)
+		drawCachedText(font,static_text,10,310);
+
+		clearFontLabelBatch(batch);
+		for(int i = 0; i < ALLOC_TEST_LABELS_COUNT; i++){
+			unsigned char label[32];
+			snprintf((char*)label,sizeof(label),"label %04d",(frame + i) % 10000);
+			transform[12] = i % 8 * 100;
+			transform[13] = 360 + i / 8 * 30;
+			addFontLabel(batch,label,transform,0);
+		}
+		drawFontLabelBatch(batch);
+#else
+		(void)static_text;
+#endif
+
+		resetFontFrame();
+
+		if(frame >= ALLOC_TEST_WARM_UP_FRAMES && alloc_test_allocations != allocations){
+			printf("Text Engine Alloc Test: Frame %d allocated %lld times (size %d)\n",frame - ALLOC_TEST_WARM_UP_FRAMES,alloc_test_allocations - allocations,size);
+			failed_frames++;
+		}
+
+	}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	glFinish();
+#endif
+
+	if(failed_frames) printf("Text Engine Alloc Test: %d of %d frames allocated\n",failed_frames,frames);
+	else printf("Text Engine Alloc Test: %d frames without allocation\n",frames);
+
+#if defined(TEXT_ENGINE_USE_MODERN_OPENGL) && !defined(TEXT_ENGINE_METRICS_ONLY)
+	deleteFontLabelBatch(batch);
+	deleteFontTextCache();
+#endif
+
+	deleteFont(font);
+	deleteFontFrameMemory();
+
+	return failed_frames ? 1 : 0;
+
+}
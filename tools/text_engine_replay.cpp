@@ -0,0 +1,459 @@
+/*
+	Text Engine Replay, replays a trace recorded with TEXT_ENGINE_TRACE (see text_engine.h) and reports its timings.
+
+	The trace runs headless, on an OpenGL context created with EGL and no window, so it can be used to benchmark any build
+	of the library against real sessions.
+
+	Compiled on linux with: g++ -O2 tools/text_engine_replay.cpp -o text_engine_replay -lEGL -lGL `pkg-config --cflags --libs freetype2`
+	Add -DTEXT_ENGINE_USE_MODERN_OPENGL to replay on the modern OpenGL path (drawCachedText is replayed as drawText on OpenGL 1.1).
+	Add -DTEXT_ENGINE_METRICS_ONLY (without -lEGL -lGL) to replay only the metrics calls, with createFontMetrics fonts.
+
+	Usage: text_engine_replay session.trace [-width 800] [-height 600] [-fonts directory]
+
+	-fonts loads the fonts from another directory, keeping the recorded file names.
+
+*/
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	#define GL_GLEXT_PROTOTYPES
+	#include<GL/gl.h>
+	#include<GL/glext.h>
+	#include<EGL/egl.h>
+	#include<EGL/eglext.h>
+#endif
+
+#define TEXT_ENGINE_IMPLEMENTATION
+#include"../text_engine.h"
+
+#define REPLAY_OPS_COUNT (TEXT_ENGINE_TRACE_DRAW_CACHED_TEXT + 1)
+
+static const char* replay_op_names[REPLAY_OPS_COUNT] = {
+	"",
+	"createFont",
+	"createFontMetrics",
+	"updateFontLoading",
+	"addFontFallback",
+	"deleteFont",
+	"drawText",
+	"getSizeText",
+	"getHeightText",
+	"setFontColor",
+	"setFontScale",
+	"setFontDepth",
+	"setTabSize",
+	"setFontCanvasSize",
+	"setFontFreeTransform",
+	"frame",
+	"drawCachedText"
+};
+
+typedef struct{
+
+	long long count, skipped;
+	long long total_time, max_time;
+
+}ReplayOpStats;
+
+static FILE* replay_file;
+static unsigned char* replay_text;
+static unsigned int replay_text_capacity;
+
+static long long replayTime(){
+
+	struct timespec time;
+	timespec_get(&time,TIME_UTC);
+
+	return time.tv_sec * 1000000000LL + time.tv_nsec;
+
+}
+
+static int replayRead(void* data, int size){
+	return fread(data,1,size,replay_file) == (size_t)size;
+}
+
+static int replayReadInt(){
+	int value = 0;
+	replayRead(&value,sizeof(int));
+	return value;
+}
+
+static float replayReadFloat(){
+	float value = 0;
+	replayRead(&value,sizeof(float));
+	return value;
+}
+
+static const unsigned char* replayReadString(){
+
+	unsigned int length = 0;
+	replayRead(&length,sizeof(unsigned int));
+
+	if(length + 1 > replay_text_capacity){
+		replay_text_capacity = length + 1;
+		replay_text = (unsigned char*)realloc(replay_text,replay_text_capacity);
+	}
+
+	replayRead(replay_text,length);
+	replay_text[length] = 0;
+
+	return replay_text;
+
+}
+
+static const char* replayFontPath(const char* recorded_path, const char* fonts_directory){
+
+	static char path[4096];
+
+	if(!fonts_directory) return recorded_path;
+
+	const char* file_name = strrchr(recorded_path,'/');
+	file_name = file_name ? file_name + 1 : recorded_path;
+	snprintf(path,sizeof(path),"%s/%s",fonts_directory,file_name);
+
+	return path;
+
+}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+
+static int replayCreateContext(int width, int height){
+
+	EGLDisplay display = EGL_NO_DISPLAY;
+
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	if(eglGetPlatformDisplayEXT)
+		display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,EGL_DEFAULT_DISPLAY,0);
+#endif
+	if(display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if(!eglInitialize(display,0,0)){
+		puts("Text Engine Replay: Failed to init EGL");
+		return 0;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE,EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,EGL_OPENGL_BIT,
+		EGL_RED_SIZE,8,EGL_GREEN_SIZE,8,EGL_BLUE_SIZE,8,EGL_ALPHA_SIZE,8,
+		EGL_DEPTH_SIZE,24,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs_count;
+	if(!eglChooseConfig(display,config_attributes,&config,1,&configs_count) || !configs_count){
+		puts("Text Engine Replay: No EGL config for OpenGL");
+		return 0;
+	}
+
+	EGLint surface_attributes[] = {EGL_WIDTH,width,EGL_HEIGHT,height,EGL_NONE};
+	EGLSurface surface = eglCreatePbufferSurface(display,config,surface_attributes);
+
+	EGLContext context = eglCreateContext(display,config,EGL_NO_CONTEXT,0);
+	if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display,surface,surface,context)){
+		puts("Text Engine Replay: Failed to create OpenGL context");
+		return 0;
+	}
+
+	glViewport(0,0,width,height);
+
+	return 1;
+
+}
+
+#endif //TEXT_ENGINE_METRICS_ONLY
+
+int main(int argc, char** argv){
+
+	const char* trace_name = 0;
+	const char* fonts_directory = 0;
+	int width = 800, height = 600;
+
+	for(int i = 1; i < argc; i++){
+		if(!strcmp(argv[i],"-width") && i + 1 < argc) width = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"-height") && i + 1 < argc) height = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"-fonts") && i + 1 < argc) fonts_directory = argv[++i];
+		else trace_name = argv[i];
+	}
+
+	if(!trace_name){
+		puts("Usage: text_engine_replay session.trace [-width 800] [-height 600] [-fonts directory]");
+		return 1;
+	}
+
+	replay_file = fopen(trace_name,"rb");
+	if(!replay_file){
+		printf("Text Engine Replay: Failed to open trace: %s\n",trace_name);
+		return 1;
+	}
+
+	char magic[4];
+	int version = 0;
+	if(!replayRead(magic,4) || memcmp(magic,"TETR",4) || !replayRead(&version,sizeof(int)) || version != TEXT_ENGINE_TRACE_VERSION){
+		printf("Text Engine Replay: %s is not a version %d trace\n",trace_name,TEXT_ENGINE_TRACE_VERSION);
+		return 1;
+	}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	if(!replayCreateContext(width,height)) return 1;
+#else
+	(void)width, (void)height;
+#endif
+
+	Font** fonts = 0;
+	int fonts_capacity = 0;
+
+	ReplayOpStats stats[REPLAY_OPS_COUNT];
+	memset(stats,0,sizeof(stats));
+
+	long long frames_count = 0, frame_min = 0, frame_max = 0, frames_time = 0;
+	long long recorded_time = 0;
+	long long replay_start = replayTime(), frame_start = replay_start;
+
+	unsigned char op;
+
+	while(replayRead(&op,1)){
+
+		long long time;
+		int font_id;
+		if(!replayRead(&time,sizeof(long long)) || !replayRead(&font_id,sizeof(int))){
+			puts("Text Engine Replay: Trace ends inside a record, stopping");
+			break;
+		}
+		recorded_time = time;
+
+		if(op == 0 || op >= REPLAY_OPS_COUNT){
+			printf("Text Engine Replay: Unknown record %d, stopping\n",op);
+			break;
+		}
+
+		if(font_id < 0){
+			printf("Text Engine Replay: Invalid font id %d, stopping\n",font_id);
+			break;
+		}
+
+		if(font_id >= fonts_capacity){
+			int old_capacity = fonts_capacity;
+			while(font_id >= fonts_capacity) fonts_capacity = fonts_capacity ? fonts_capacity * 2 : 64;
+			fonts = (Font**)realloc(fonts,sizeof(Font*)*fonts_capacity);
+			memset(fonts + old_capacity,0,sizeof(Font*)*(fonts_capacity - old_capacity));
+		}
+
+		//Arguments are read before the clock starts, only the library call is timed
+		Font* font = fonts[font_id];
+		int skipped = !font && op != TEXT_ENGINE_TRACE_CREATE_FONT && op != TEXT_ENGINE_TRACE_CREATE_FONT_METRICS && op != TEXT_ENGINE_TRACE_FRAME;
+		long long start = 0, elapsed = 0;
+
+		switch(op){
+
+			case TEXT_ENGINE_TRACE_CREATE_FONT:
+			case TEXT_ENGINE_TRACE_CREATE_FONT_METRICS:{
+				int size = replayReadInt();
+				const char* path = replayFontPath((const char*)replayReadString(),fonts_directory);
+				start = replayTime();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(op == TEXT_ENGINE_TRACE_CREATE_FONT)
+					fonts[font_id] = createFontAsync(path,size);
+				else
+#endif
+					fonts[font_id] = createFontMetrics(path,size);
+				elapsed = replayTime() - start;
+				skipped = !fonts[font_id];
+			}break;
+
+			case TEXT_ENGINE_TRACE_UPDATE_FONT_LOADING:{
+				int bytes_budget = replayReadInt();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only){
+					start = replayTime();
+					updateFontLoading(font,bytes_budget);
+					elapsed = replayTime() - start;
+				}else skipped = 1;
+#else
+				(void)bytes_budget;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_ADD_FONT_FALLBACK:{
+				const char* path = replayFontPath((const char*)replayReadString(),fonts_directory);
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only){
+					start = replayTime();
+					addFontFallback(font,path);
+					elapsed = replayTime() - start;
+				}else skipped = 1;
+#else
+				(void)path;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_DELETE_FONT:{
+				if(!skipped){
+					start = replayTime();
+					deleteFont(font);
+					elapsed = replayTime() - start;
+					fonts[font_id] = 0;
+				}
+			}break;
+
+			case TEXT_ENGINE_TRACE_DRAW_TEXT:
+			case TEXT_ENGINE_TRACE_DRAW_CACHED_TEXT:{
+				int x = replayReadInt();
+				int y = replayReadInt();
+				const unsigned char* text = replayReadString();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only){
+					start = replayTime();
+#ifdef TEXT_ENGINE_USE_MODERN_OPENGL
+					if(op == TEXT_ENGINE_TRACE_DRAW_CACHED_TEXT)
+						drawCachedText(font,text,x,y);
+					else
+#endif
+						drawText(font,text,x,y);
+					elapsed = replayTime() - start;
+				}else skipped = 1;
+#else
+				(void)x, (void)y, (void)text;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_GET_SIZE_TEXT:
+			case TEXT_ENGINE_TRACE_GET_HEIGHT_TEXT:{
+				const unsigned char* text = replayReadString();
+				if(!skipped){
+					start = replayTime();
+					volatile int result = op == TEXT_ENGINE_TRACE_GET_SIZE_TEXT ? getSizeText(font,text) : getHeightText(font,text);
+					elapsed = replayTime() - start;
+					(void)result;
+				}
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_FONT_COLOR:{
+				float r = replayReadFloat(), g = replayReadFloat(), b = replayReadFloat(), a = replayReadFloat();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only) setFontColor(font,r,g,b,a);
+				else skipped = 1;
+#else
+				(void)r, (void)g, (void)b, (void)a;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_FONT_SCALE:{
+				float scale_x = replayReadFloat(), scale_y = replayReadFloat();
+				if(!skipped){
+					font->scale_x = scale_x;
+					font->scale_y = scale_y;
+				}
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_FONT_DEPTH:{
+				float depth = replayReadFloat();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only) setFontDepth(font,depth);
+				else skipped = 1;
+#else
+				(void)depth;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_TAB_SIZE:{
+				int tab_size = replayReadInt();
+				if(!skipped) setTabSize(font,tab_size);
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_FONT_CANVAS_SIZE:{
+				int canvas_width = replayReadInt(), canvas_height = replayReadInt(), canvas_depth = replayReadInt();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only) setFontCanvasSize(font,canvas_width,canvas_height,canvas_depth);
+				else skipped = 1;
+#else
+				(void)canvas_width, (void)canvas_height, (void)canvas_depth;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_SET_FONT_FREE_TRANSFORM:{
+				int free_transform = replayReadInt();
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				if(!skipped && !font->metrics_only) setFontFreeTransform(font,free_transform);
+				else skipped = 1;
+#else
+				(void)free_transform;
+				skipped = 1;
+#endif
+			}break;
+
+			case TEXT_ENGINE_TRACE_FRAME:{
+				//Frame time includes the GPU work of the frame
+#ifndef TEXT_ENGINE_METRICS_ONLY
+				glFinish();
+#endif
+				resetFontFrame();
+				long long now = replayTime();
+				long long frame_time = now - frame_start;
+				frame_start = now;
+				if(!frames_count || frame_time < frame_min) frame_min = frame_time;
+				if(frame_time > frame_max) frame_max = frame_time;
+				frames_time += frame_time;
+				frames_count++;
+				elapsed = frame_time;
+			}break;
+
+		}
+
+		ReplayOpStats* op_stats = &stats[op];
+		if(skipped){
+			op_stats->skipped++;
+			continue;
+		}
+		op_stats->count++;
+		op_stats->total_time += elapsed;
+		if(elapsed > op_stats->max_time) op_stats->max_time = elapsed;
+
+	}
+
+#ifndef TEXT_ENGINE_METRICS_ONLY
+	glFinish();
+#endif
+	long long replay_time = replayTime() - replay_start;
+
+	printf("Trace: %s\n",trace_name);
+	printf("Recorded session: %.3f ms, replay: %.3f ms\n",recorded_time / 1000000.0,replay_time / 1000000.0);
+	if(frames_count)
+		printf("Frames: %lld, average %.3f ms, min %.3f ms, max %.3f ms\n",frames_count,frames_time / 1000000.0 / frames_count,frame_min / 1000000.0,frame_max / 1000000.0);
+
+	printf("\n%-22s %10s %10s %12s %12s %12s\n","call","count","skipped","total ms","average us","max us");
+	for(int i = 1; i < REPLAY_OPS_COUNT; i++){
+		ReplayOpStats* op_stats = &stats[i];
+		if(i == TEXT_ENGINE_TRACE_FRAME || (!op_stats->count && !op_stats->skipped)) continue;
+		printf("%-22s %10lld %10lld %12.3f %12.3f %12.3f\n",replay_op_names[i],op_stats->count,op_stats->skipped,
+			op_stats->total_time / 1000000.0,op_stats->count ? op_stats->total_time / 1000.0 / op_stats->count : 0.0,op_stats->max_time / 1000.0);
+	}
+
+	for(int i = 0; i < fonts_capacity; i++)
+		if(fonts[i]) deleteFont(fonts[i]);
+	
+#if defined(TEXT_ENGINE_USE_MODERN_OPENGL) && !defined(TEXT_ENGINE_METRICS_ONLY)
+	deleteFontTextCache();
+#endif
+
+	deleteFontFrameMemory();
+	free(fonts);
+	free(replay_text);
+	fclose(replay_file);
+
+	return 0;
+
+}